@@ -3,6 +3,17 @@
 #include "System.h"
 #include "RenderCommand.h"
 #include "StackAllocator.h"
+#include "ConcurrentBuddyAllocator.hpp"
+#include "ConcurrentPoolAllocator.h"
+#include "GrowablePoolAllocator.h"
+#include "PoolSlotMap.h"
+#include "SmallObjectAllocator.h"
+#include "SlabAllocator.hpp"
+#include "BuddyMemoryResource.hpp"
+#include "CompactingBuddyHeap.hpp"
+#include <map>
+#include <random>
+#include <numeric>
 
 #define MEGA 1000000ll
 #define GIGA 1000000000ll
@@ -91,6 +102,8 @@ void Application::Run() noexcept
 				BuddyAllocate();
 			if (m_buddyDealloc)
 				BuddyDeallocate();
+			if (m_buddyGrowable)
+				m_buddyHeap.releaseIdleArenas();
 		}
 
 		DisplayProfilingResults();
@@ -374,9 +387,61 @@ void Application::RenderBuddyAllocatorSettingsPanel() noexcept
 		ImGui::InputInt("Size of allocations", &m_buddyAllocationSize, 512);
 		ImGui::InputInt("Number of allocations", &m_buddyAllocationCount, 1000);
 		ImGui::Checkbox("Deallocate", &m_buddyDealloc);
-		if (ImGui::Button("Reset"))
+		if (ImGui::Checkbox("Growable heap (adds 1 GiB arenas when full)", &m_buddyGrowable))
 		{
+			//Outstanding allocations belong to the other allocator, drop them.
 			m_buddyAllocator.reset();
+			m_buddyHeap.reset();
+			m_buddyAllocatedCount = 0;
+		}
+		if (ImGui::Checkbox("Deferred coalescing", &m_buddyDeferredCoalescing))
+		{
+			m_buddyAllocator.setDeferredCoalescing(m_buddyDeferredCoalescing);
+			m_buddyHeap.setDeferredCoalescing(m_buddyDeferredCoalescing);
+		}
+		if (ImGui::Button("Reset"))
+		{
+			m_buddyAllocator.reset(true);
+			m_buddyHeap.reset(true);
+			m_buddyAllocatedCount = 0;
+			m_buddyUnusedMemory = m_buddyGrowable ? m_buddyHeap.getUnusedMemory() : m_buddyAllocator.getUnusedMemory();
+			m_buddyStats = m_buddyGrowable ? m_buddyHeap.getStats() : m_buddyAllocator.getStats();
+		}
+		if (ImGui::Button("Test - Merge cascade (256 MiB of 512 byte blocks)"))
+		{
+			PerformBuddyAllocatorMergeTest();
+		}
+		if (ImGui::Button("Test - Contention (1..N threads, 512-4096 byte blocks)"))
+		{
+			PerformBuddyAllocatorContentionTest();
+		}
+		if (ImGui::Button("Test - Vector growth (realloc 64 B -> 256 KiB)"))
+		{
+			PerformBuddyAllocatorReallocTest();
+		}
+		if (ImGui::Button("Test - Deferred coalescing (steady-state frame)"))
+		{
+			PerformBuddyAllocatorDeferredCoalescingTest();
+		}
+		if (ImGui::Button("Test - pmr containers (map inserts, vector growth)"))
+		{
+			PerformBuddyMemoryResourceTest();
+		}
+		if (ImGui::Button("Test - Random touch (small vs huge pages)"))
+		{
+			PerformHugePageTest();
+		}
+		if (ImGui::Button("Test - Compaction (1 ms per frame)"))
+		{
+			PerformBuddyCompactionTest();
+		}
+		if (ImGui::Button("Test - Aligned allocation telemetry"))
+		{
+			PerformBuddyAlignedTelemetryTest();
+		}
+		if (ImGui::Button("Test - Slab vs buddy (100 000 cubes)"))
+		{
+			PerformSlabAllocatorTest();
 		}
 		RenderBuddyProgressBar();
 	}
@@ -396,41 +461,657 @@ void Application::BuddyAllocate() noexcept
 		m_buddyAllocations.clear();
 		m_buddyAllocations.resize(m_buddyAllocationCount);
 	}
-	if (m_buddyDealloc) { m_buddyAllocator.reset(); }
+	if (m_buddyDealloc)
+	{
+		if (m_buddyGrowable)
+			m_buddyHeap.reset();
+		else
+			m_buddyAllocator.reset();
+	}
 
 	std::string str = __FUNCTION__ " (" + std::to_string(m_buddyAllocationCount) + ")";
 	{
 		PROFILE_SCOPE(str);
-		m_buddyAllocatorFull = false;
-		for (auto i = 0u; i < m_buddyAllocationCount; ++i)
+		if (m_buddyGrowable)
+			m_buddyAllocatedCount = m_buddyHeap.alloc_bulk(m_buddyAllocationSize, m_buddyAllocationCount, m_buddyAllocations.data());
+		else
+			m_buddyAllocatedCount = m_buddyAllocator.alloc_bulk(m_buddyAllocationSize, m_buddyAllocationCount, m_buddyAllocations.data());
+		m_buddyAllocatorFull = m_buddyAllocatedCount < static_cast<size_t>(m_buddyAllocationCount);
+	}
+	m_buddyUnusedMemory = m_buddyGrowable ? m_buddyHeap.getUnusedMemory() : m_buddyAllocator.getUnusedMemory();
+	m_buddyStats = m_buddyGrowable ? m_buddyHeap.getStats() : m_buddyAllocator.getStats();
+}
+
+void Application::BuddyDeallocate() noexcept
+{
+	std::string str = __FUNCTION__ " (" + std::to_string(m_buddyAllocationCount) + ")";
+	PROFILE_SCOPE(str);
+	if (m_buddyGrowable)
+		m_buddyHeap.free_bulk(m_buddyAllocations.data(), m_buddyAllocatedCount, m_buddyAllocationSize);
+	else
+		m_buddyAllocator.free_bulk(m_buddyAllocations.data(), m_buddyAllocatedCount, m_buddyAllocationSize);
+	m_buddyAllocatedCount = 0;
+}
+
+void Application::PerformBuddyAllocatorMergeTest() noexcept
+{
+	m_TestResults.clear();
+	//Fill the heap with minimum-size blocks so that every free ends up merging in mergeNode.
+	using MergeTestAllocator = BuddyAllocator<9, 28>;
+	auto pBuddyAllocator = std::make_unique<MergeTestAllocator>();
+	const size_t nrOfBlocks = MergeTestAllocator::MAX_BLOCK / MergeTestAllocator::MIN_BLOCK;
+	std::vector<void*> blocks(nrOfBlocks);
+
+	//Freeing in a random order scatters the pair-bit and free-list accesses across the tree.
+	std::vector<size_t> randomOrder(nrOfBlocks);
+	std::iota(randomOrder.begin(), randomOrder.end(), size_t{0});
+	std::shuffle(randomOrder.begin(), randomOrder.end(), std::mt19937{1337u});
+
+	float sequentialTimeSum = 0.0f;
+	float randomTimeSum = 0.0f;
+	const std::string str1 = "Buddy merge: sequential free - " + std::to_string(nrOfBlocks) + " blocks";
+	const std::string str2 = "Buddy merge: random free - " + std::to_string(nrOfBlocks) + " blocks";
+	for (uint64_t i{ 0u }; i < 10u; i++)
+	{
+		for (size_t j = 0; j < nrOfBlocks; j++)
 		{
-			m_buddyAllocations[i] = m_buddyAllocator.alloc(m_buddyAllocationSize);
+			blocks[j] = pBuddyAllocator->alloc(MergeTestAllocator::MIN_BLOCK);
+		}
+		{
+			PROFILE_TEST(str1.c_str());
+			for (size_t j = 0; j < nrOfBlocks; j++)
+			{
+				pBuddyAllocator->free(blocks[j], MergeTestAllocator::MIN_BLOCK);
+			}
+		}
+		sequentialTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
 
-			if (!m_buddyAllocations[i])
+		for (size_t j = 0; j < nrOfBlocks; j++)
+		{
+			blocks[j] = pBuddyAllocator->alloc(MergeTestAllocator::MIN_BLOCK);
+		}
+		{
+			PROFILE_TEST(str2.c_str());
+			for (size_t j = 0; j < nrOfBlocks; j++)
 			{
-				m_buddyAllocatorFull = true;
-				break;
+				pBuddyAllocator->free(blocks[randomOrder[j]], MergeTestAllocator::MIN_BLOCK);
 			}
 		}
+		randomTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
 	}
-	m_buddyUnusedMemory = m_buddyAllocator.getUnusedMemory();
+
+	//The same random frees replayed on the tree bits alone, in the previous layout (one free bit
+	//per node, std::bitset inside the allocator) and in the pair layout. The free lists are the same
+	//in both, so this isolates what the layout changes in mergeNode.
+	constexpr int levels = MergeTestAllocator::LEVELS;
+	std::vector<uint64_t> nodeBits(((size_t{1} << levels) - 1 + 63) / 64);
+	std::vector<uint64_t> pairBits(((size_t{1} << (levels - 1)) - 1 + 63) / 64);
+	auto testBit = [](const std::vector<uint64_t>& bits, size_t index) { return ((bits[index / 64] >> (index % 64)) & 1) != 0; };
+	auto flipBit = [&](std::vector<uint64_t>& bits, size_t index) { bits[index / 64] ^= uint64_t{1} << (index % 64); return testBit(bits, index); };
+	//Set bit = free node. Merging clears the buddy's bit and moves up, the last node gets its bit set.
+	auto freeInNodeLayout = [&](size_t inLevel)
+	{
+		int level = levels - 1;
+		while (level > 0 && testBit(nodeBits, ((size_t{1} << level) - 1) + (inLevel ^ 1)))
+		{
+			flipBit(nodeBits, ((size_t{1} << level) - 1) + (inLevel ^ 1));
+			inLevel >>= 1;
+			--level;
+		}
+		flipBit(nodeBits, ((size_t{1} << level) - 1) + inLevel);
+	};
+	//Set bit = exactly one of the pair is free, like BuddyAllocator::togglePair.
+	auto freeInPairLayout = [&](size_t inLevel)
+	{
+		int level = levels - 1;
+		while (level > 0 && !flipBit(pairBits, ((size_t{1} << (level - 1)) - 1) + (inLevel >> 1)))
+		{
+			inLevel >>= 1;
+			--level;
+		}
+	};
+
+	float nodeLayoutTimeSum = 0.0f;
+	float pairLayoutTimeSum = 0.0f;
+	const size_t nodeLayoutBytes = nodeBits.size() * sizeof(uint64_t);
+	const size_t pairLayoutBytes = pairBits.size() * sizeof(uint64_t);
+	const std::string str3 = "Tree bits only, previous per-node layout (" + std::to_string(nodeLayoutBytes / 1024) + " KiB): random free";
+	const std::string str4 = "Tree bits only, pair layout (" + std::to_string(pairLayoutBytes / 1024) + " KiB): random free";
+	for (uint64_t i{ 0u }; i < 10u; i++)
+	{
+		//All zero is a fully allocated tree in both layouts.
+		std::fill(nodeBits.begin(), nodeBits.end(), uint64_t{0});
+		std::fill(pairBits.begin(), pairBits.end(), uint64_t{0});
+		{
+			PROFILE_TEST(str3.c_str());
+			for (size_t j = 0; j < nrOfBlocks; j++)
+			{
+				freeInNodeLayout(randomOrder[j]);
+			}
+		}
+		nodeLayoutTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		{
+			PROFILE_TEST(str4.c_str());
+			for (size_t j = 0; j < nrOfBlocks; j++)
+			{
+				freeInPairLayout(randomOrder[j]);
+			}
+		}
+		pairLayoutTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+	}
+
+	ProfileMetrics result = {};
+	result.Name = str1.c_str();
+	result.Duration = sequentialTimeSum / 10.0f;
+	m_TestResults.push_back(result);
+	result.Name = str2.c_str();
+	result.Duration = randomTimeSum / 10.0f;
+	m_TestResults.push_back(result);
+	result.Name = str3.c_str();
+	result.Duration = nodeLayoutTimeSum / 10.0f;
+	m_TestResults.push_back(result);
+	result.Name = str4.c_str();
+	result.Duration = pairLayoutTimeSum / 10.0f;
+	m_TestResults.push_back(result);
+
+	m_RepeatedTests.clear();
 }
 
-void Application::BuddyDeallocate() noexcept
+void Application::PerformBuddyAllocatorContentionTest() noexcept
 {
-	std::string str = __FUNCTION__ " (" + std::to_string(m_buddyAllocationCount) + ")";
-	PROFILE_SCOPE(str);
-	std::for_each(m_buddyAllocations.begin(), m_buddyAllocations.end(), [this](void* ptr) { m_buddyAllocator.free(ptr, m_buddyAllocationSize); });
+	m_TestResults.clear();
+	using ContentionTestAllocator = ConcurrentBuddyAllocator<9, 30>;
+	const uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	const uint32_t nrOfAllocations = 50000; //Per thread.
+	const uint32_t batchSize = 64;
+
+	//Every thread allocates a batch and frees it again, like BuddyAllocate + BuddyDeallocate.
+	auto sharedHeapWork = [&](ContentionTestAllocator& allocator)
+	{
+		void* blocks[batchSize];
+		for (uint32_t i = 0; i < nrOfAllocations; i += batchSize)
+		{
+			for (uint32_t j = 0; j < batchSize; j++)
+				blocks[j] = allocator.alloc(512u << (j % 4));
+			for (uint32_t j = 0; j < batchSize; j++)
+				allocator.free(blocks[j], 512u << (j % 4));
+		}
+	};
+	auto threadCacheWork = [&](ContentionTestAllocator& allocator)
+	{
+		ContentionTestAllocator::ThreadCache cache(allocator);
+		void* blocks[batchSize];
+		for (uint32_t i = 0; i < nrOfAllocations; i += batchSize)
+		{
+			for (uint32_t j = 0; j < batchSize; j++)
+				blocks[j] = cache.alloc(512u << (j % 4));
+			for (uint32_t j = 0; j < batchSize; j++)
+				cache.free(blocks[j], 512u << (j % 4));
+		}
+	};
+
+	//1, 2, 4, ... threads and finally every hardware thread.
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t nrOfThreads = 1u; nrOfThreads < maxThreads; nrOfThreads *= 2u)
+		threadCounts.push_back(nrOfThreads);
+	threadCounts.push_back(maxThreads);
+
+	for (const uint32_t nrOfThreads : threadCounts)
+	{
+		auto pAllocator = std::make_unique<ContentionTestAllocator>();
+		float sharedTimeSum = 0.0f;
+		float cachedTimeSum = 0.0f;
+		std::string str1 = "Buddy contention, shared lock: " + std::to_string(nrOfThreads) + " threads x " + std::to_string(nrOfAllocations) + " allocations";
+		std::string str2 = "Buddy contention, thread caches: " + std::to_string(nrOfThreads) + " threads x " + std::to_string(nrOfAllocations) + " allocations";
+		for (uint64_t i{ 0u }; i < 10u; i++)
+		{
+			{
+				PROFILE_TEST(str1.c_str());
+				std::vector<std::thread> threads;
+				for (uint32_t t = 0; t < nrOfThreads; t++)
+					threads.emplace_back(sharedHeapWork, std::ref(*pAllocator));
+				for (auto& thread : threads)
+					thread.join();
+			}
+			sharedTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+			{
+				PROFILE_TEST(str2.c_str());
+				std::vector<std::thread> threads;
+				for (uint32_t t = 0; t < nrOfThreads; t++)
+					threads.emplace_back(threadCacheWork, std::ref(*pAllocator));
+				for (auto& thread : threads)
+					thread.join();
+			}
+			cachedTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		}
+
+		ProfileMetrics result = {};
+		result.Name = str1.c_str();
+		result.Duration = sharedTimeSum / 10.0f;
+		m_TestResults.push_back(result);
+		result.Name = str2.c_str();
+		result.Duration = cachedTimeSum / 10.0f;
+		m_TestResults.push_back(result);
+
+		m_RepeatedTests.clear();
+	}
+}
+
+void Application::PerformBuddyAllocatorReallocTest() noexcept
+{
+	m_TestResults.clear();
+	using ReallocTestAllocator = BuddyAllocator<6, 26>;
+	auto pBuddyAllocator = std::make_unique<ReallocTestAllocator>();
+	const size_t startSize = 64;
+	const size_t endSize = 256 * 1024;
+
+	//Arrays that double their size, like std::vector. With one array the right buddy
+	//is always free; growing several round-robin makes them compete for it.
+	for (const size_t nrOfArrays : { size_t{1}, size_t{16} })
+	{
+		std::vector<void*> arrays(nrOfArrays);
+		float buddyTimeSum = 0.0f;
+		float crtTimeSum = 0.0f;
+		std::string str1 = "Buddy realloc: " + std::to_string(nrOfArrays) + " arrays growing 64 B -> 256 KiB";
+		std::string str2 = "std::realloc: " + std::to_string(nrOfArrays) + " arrays growing 64 B -> 256 KiB";
+		for (uint64_t i{ 0u }; i < 10u; i++)
+		{
+			{
+				PROFILE_TEST(str1.c_str());
+				for (size_t j = 0; j < 100; j++)
+				{
+					for (auto& pArray : arrays)
+						pArray = pBuddyAllocator->alloc(startSize);
+					for (size_t size = startSize; size < endSize; size *= 2)
+					{
+						for (auto& pArray : arrays)
+							pArray = pBuddyAllocator->realloc(pArray, size, size * 2);
+					}
+					for (auto& pArray : arrays)
+						pBuddyAllocator->free(pArray, endSize);
+				}
+			}
+			buddyTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+			{
+				PROFILE_TEST(str2.c_str());
+				for (size_t j = 0; j < 100; j++)
+				{
+					for (auto& pArray : arrays)
+						pArray = std::malloc(startSize);
+					for (size_t size = startSize; size < endSize; size *= 2)
+					{
+						for (auto& pArray : arrays)
+							pArray = std::realloc(pArray, size * 2);
+					}
+					for (auto& pArray : arrays)
+						std::free(pArray);
+				}
+			}
+			crtTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		}
+
+		ProfileMetrics result = {};
+		result.Name = str1.c_str();
+		result.Duration = buddyTimeSum / 10.0f;
+		m_TestResults.push_back(result);
+		result.Name = str2.c_str();
+		result.Duration = crtTimeSum / 10.0f;
+		m_TestResults.push_back(result);
+
+		m_RepeatedTests.clear();
+	}
+}
+
+void Application::PerformBuddyAllocatorDeferredCoalescingTest() noexcept
+{
+	m_TestResults.clear();
+	using FrameTestAllocator = BuddyAllocator<9, 28>;
+	auto pBuddyAllocator = std::make_unique<FrameTestAllocator>();
+	const size_t nrOfBlocks = 20000;
+
+	//Every frame allocates the same mix of 512 B - 8 KiB blocks and frees all of them again.
+	std::vector<size_t> sizes(nrOfBlocks);
+	std::mt19937 rng{1337u};
+	for (auto& size : sizes)
+		size = size_t{512} << (rng() % 5);
+	std::vector<void*> blocks(nrOfBlocks);
+
+	for (const bool deferred : { false, true })
+	{
+		pBuddyAllocator->reset();
+		pBuddyAllocator->setDeferredCoalescing(deferred);
+		float frameTimeSum = 0.0f;
+		std::string str = std::string(deferred ? "Buddy frame, deferred coalescing: " : "Buddy frame, immediate coalescing: ") + std::to_string(nrOfBlocks) + " blocks";
+		for (uint64_t i{ 0u }; i < 11u; i++)
+		{
+			{
+				PROFILE_TEST(str.c_str());
+				for (size_t j = 0; j < nrOfBlocks; j++)
+				{
+					blocks[j] = pBuddyAllocator->alloc(sizes[j]);
+				}
+				for (size_t j = 0; j < nrOfBlocks; j++)
+				{
+					pBuddyAllocator->free(blocks[j], sizes[j]);
+				}
+			}
+			//The first frame splits the tree in both modes, only steady-state frames count.
+			if (i > 0)
+				frameTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		}
+
+		ProfileMetrics result = {};
+		result.Name = str.c_str();
+		result.Duration = frameTimeSum / 10.0f;
+		m_TestResults.push_back(result);
+		m_RepeatedTests.clear();
+	}
+}
+
+void Application::PerformBuddyMemoryResourceTest() noexcept
+{
+	m_TestResults.clear();
+	using ResourceTestAllocator = BuddyAllocator<6, 28>;
+	auto pBuddyAllocator = std::make_unique<ResourceTestAllocator>();
+	BuddyMemoryResource<ResourceTestAllocator> buddyResource(*pBuddyAllocator);
+	const size_t nrOfInserts = 100000;
+	const size_t nrOfVectors = 100;
+	const size_t nrOfElements = 10000;
+
+	std::vector<int> keys(nrOfInserts);
+	std::iota(keys.begin(), keys.end(), 0);
+	std::shuffle(keys.begin(), keys.end(), std::mt19937{1337u});
+
+	for (std::pmr::memory_resource* pResource : { static_cast<std::pmr::memory_resource*>(&buddyResource), std::pmr::get_default_resource() })
+	{
+		const std::string name = pResource == &buddyResource ? "Buddy resource" : "Default resource";
+		const std::string str1 = name + ": pmr::map " + std::to_string(nrOfInserts) + " inserts";
+		const std::string str2 = name + ": " + std::to_string(nrOfVectors) + " pmr::vectors growing to " + std::to_string(nrOfElements);
+		float mapTimeSum = 0.0f;
+		float vectorTimeSum = 0.0f;
+		for (uint64_t i{ 0u }; i < 10u; i++)
+		{
+			{
+				PROFILE_TEST(str1.c_str());
+				std::pmr::map<int, int> map(pResource);
+				for (const int key : keys)
+				{
+					map.emplace(key, key);
+				}
+			}
+			mapTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+			{
+				PROFILE_TEST(str2.c_str());
+				std::pmr::vector<std::pmr::vector<int>> vectors(nrOfVectors, std::pmr::vector<int>(pResource), pResource);
+				for (size_t j = 0; j < nrOfElements; j++)
+				{
+					for (auto& vector : vectors)
+						vector.push_back(static_cast<int>(j));
+				}
+			}
+			vectorTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		}
+
+		ProfileMetrics result = {};
+		result.Name = str1.c_str();
+		result.Duration = mapTimeSum / 10.0f;
+		m_TestResults.push_back(result);
+		result.Name = str2.c_str();
+		result.Duration = vectorTimeSum / 10.0f;
+		m_TestResults.push_back(result);
+		m_RepeatedTests.clear();
+	}
+}
+
+void Application::PerformHugePageTest() noexcept
+{
+	m_TestResults.clear();
+	using TouchTestAllocator = BuddyAllocator<9, 28>;
+	const size_t nrOfTouches = 16 * 1024 * 1024;
+	const size_t nrOfWords = TouchTestAllocator::MAX_BLOCK / sizeof(uint64_t);
+
+	for (const PageBacking backing : { PageBacking::Small, PageBacking::Huge })
+	{
+		auto pBuddyAllocator = std::make_unique<TouchTestAllocator>(backing);
+		uint64_t* pWords = static_cast<uint64_t*>(pBuddyAllocator->alloc(TouchTestAllocator::MAX_BLOCK));
+		//Fault every page in first, only the TLB behaviour of the random accesses is measured.
+		std::memset(pWords, 0, TouchTestAllocator::MAX_BLOCK);
+
+		const char* backingName = pBuddyAllocator->getPageBacking() == PageBacking::Huge ? "huge pages" : "small pages";
+		std::string str = "Random touch 256 MiB, " + std::string(backingName) + (backing != pBuddyAllocator->getPageBacking() ? " (huge not available)" : "") + ": " + std::to_string(nrOfTouches) + " touches";
+		float timeSum = 0.0f;
+		for (uint64_t i{ 0u }; i < 10u; i++)
+		{
+			uint64_t state = 0x9E3779B97F4A7C15ull + i;
+			{
+				PROFILE_TEST(str.c_str());
+				for (size_t j = 0; j < nrOfTouches; j++)
+				{
+					//xorshift64, cheap enough not to hide the cache and TLB misses.
+					state ^= state << 13;
+					state ^= state >> 7;
+					state ^= state << 17;
+					pWords[state & (nrOfWords - 1)]++;
+				}
+			}
+			timeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		}
+		pBuddyAllocator->free(pWords, TouchTestAllocator::MAX_BLOCK);
+
+		ProfileMetrics result = {};
+		result.Name = str.c_str();
+		result.Duration = timeSum / 10.0f;
+		m_TestResults.push_back(result);
+		m_RepeatedTests.clear();
+	}
+}
+
+void Application::PerformBuddyCompactionTest() noexcept
+{
+	m_TestResults.clear();
+	using TestHeap = CompactingBuddyHeap<9, 28>;
+	auto pHeap = std::make_unique<TestHeap>();
+
+	//Fill the heap with 512 B - 4 KiB blocks and free three out of four, like a long session would.
+	std::mt19937 rng{1337u};
+	std::vector<BuddyHandle> handles;
+	while (BuddyHandle handle = pHeap->alloc(size_t{512} << (rng() % 4)))
+	{
+		handles.push_back(handle);
+	}
+	for (const BuddyHandle handle : handles)
+	{
+		if (rng() % 4)
+			pHeap->free(handle);
+	}
+	const size_t largestBefore = pHeap->getStats().largestFreeBlock;
+
+	//One compaction slice per simulated frame until a pass finds nothing left to move.
+	size_t nrOfFrames = 0;
+	size_t movedBytes = 0;
+	float timeSum = 0.0f;
+	float maxFrameTime = 0.0f;
+	do
+	{
+		{
+			PROFILE_TEST("Compaction");
+			movedBytes += pHeap->compact(std::chrono::milliseconds(1));
+		}
+		const float frameTime = m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		timeSum += frameTime;
+		maxFrameTime = frameTime > maxFrameTime ? frameTime : maxFrameTime;
+		nrOfFrames++;
+	} while (!pHeap->isSettled());
+	const size_t largestAfter = pHeap->getStats().largestFreeBlock;
+
+	ProfileMetrics result = {};
+	result.Name = "Compaction: " + std::to_string(nrOfFrames) + " frames, " + std::to_string(movedBytes / 1024) + " KiB moved, largest free block "
+		+ std::to_string(largestBefore / 1024) + " KiB -> " + std::to_string(largestAfter / 1024) + " KiB (average frame)";
+	result.Duration = timeSum / static_cast<float>(nrOfFrames);
+	m_TestResults.push_back(result);
+	result.Name = "Compaction: longest frame";
+	result.Duration = maxFrameTime;
+	m_TestResults.push_back(result);
+
+	m_RepeatedTests.clear();
+}
+
+void Application::PerformBuddyAlignedTelemetryTest() noexcept
+{
+	m_TestResults.clear();
+	using TelemetryHeap = BuddyAllocator<4, 16>;
+	auto pAllocator = std::make_unique<TelemetryHeap>();
+
+	//An over-aligned block sits above the level its size maps to, freeing it by size must still only take its own bytes off.
+	ProfileMetrics result = {};
+	void* pSmall = pAllocator->alloc(100);
+	void* pAligned1 = pAllocator->alloc_aligned(16, 4096);
+	void* pAligned2 = pAllocator->alloc_aligned(16, 4096);
+	pAllocator->free(pAligned1, 16);
+	result.Name = "Requested bytes after alloc(100), 2x alloc_aligned(16, 4096), free(ptr, 16): "
+		+ std::to_string(pAllocator->getStats().requestedBytes) + " (expected 116)";
+	m_TestResults.push_back(result);
+	pAllocator->free(pAligned2);
+	result.Name = "Requested bytes after the other aligned block is freed with free(ptr): "
+		+ std::to_string(pAllocator->getStats().requestedBytes) + " (expected 100)";
+	m_TestResults.push_back(result);
+	pAllocator->free(pSmall, 100);
+
+	//The heap has to hand the real size on to its arena, not the alignment.
+	BuddyHeap<4, 16> heap;
+	void* pHeapAligned = heap.alloc_aligned(16, 4096);
+	result.Name = "Heap requested bytes after alloc_aligned(16, 4096): "
+		+ std::to_string(heap.getStats().requestedBytes) + " (expected 16)";
+	m_TestResults.push_back(result);
+	heap.free(pHeapAligned, 16);
+}
+
+void Application::PerformSlabAllocatorTest() noexcept
+{
+	m_TestResults.clear();
+	using SlabTestHeap = BuddyAllocator<9, 28>;
+	auto pBuddyAllocator = std::make_unique<SlabTestHeap>();
+	const size_t nrOfCubes = 100000;
+	std::vector<Cube*> cubes(nrOfCubes);
+
+	//Memory is measured on the first round, the slab keeps one empty slab per class afterwards.
+	size_t slabMemory = 0;
+	size_t buddyMemory = 0;
+	float slabAllocTimeSum = 0.0f;
+	float slabFreeTimeSum = 0.0f;
+	float buddyAllocTimeSum = 0.0f;
+	float buddyFreeTimeSum = 0.0f;
+	{
+		SlabAllocator<SlabTestHeap> slabAllocator(*pBuddyAllocator);
+		for (uint64_t i{ 0u }; i < 10u; i++)
+		{
+			{
+				PROFILE_TEST("Slab");
+				for (size_t j = 0; j < nrOfCubes; j++)
+				{
+					cubes[j] = slabAllocator.New<Cube>();
+				}
+			}
+			slabAllocTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+			if (i == 0)
+				slabMemory = SlabTestHeap::MAX_BLOCK - pBuddyAllocator->getUnusedMemory();
+			{
+				PROFILE_TEST("Slab");
+				for (size_t j = 0; j < nrOfCubes; j++)
+				{
+					slabAllocator.Delete(cubes[j]);
+				}
+			}
+			slabFreeTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		}
+	}
+	for (uint64_t i{ 0u }; i < 10u; i++)
+	{
+		{
+			PROFILE_TEST("Buddy");
+			for (size_t j = 0; j < nrOfCubes; j++)
+			{
+				cubes[j] = new (pBuddyAllocator->alloc(sizeof(Cube))) Cube;
+			}
+		}
+		buddyAllocTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		if (i == 0)
+			buddyMemory = SlabTestHeap::MAX_BLOCK - pBuddyAllocator->getUnusedMemory();
+		{
+			PROFILE_TEST("Buddy");
+			for (size_t j = 0; j < nrOfCubes; j++)
+			{
+				cubes[j]->~Cube();
+				pBuddyAllocator->free(cubes[j], sizeof(Cube));
+			}
+		}
+		buddyFreeTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+	}
+
+	const std::string count = std::to_string(nrOfCubes);
+	ProfileMetrics result = {};
+	result.Name = "Slab allocation: " + count + " cubes (" + std::to_string(slabMemory / 1024) + " KiB)";
+	result.Duration = slabAllocTimeSum / 10.0f;
+	m_TestResults.push_back(result);
+	result.Name = "Slab deallocation: " + count + " cubes";
+	result.Duration = slabFreeTimeSum / 10.0f;
+	m_TestResults.push_back(result);
+	result.Name = "Buddy allocation: " + count + " cubes (" + std::to_string(buddyMemory / 1024) + " KiB)";
+	result.Duration = buddyAllocTimeSum / 10.0f;
+	m_TestResults.push_back(result);
+	result.Name = "Buddy deallocation: " + count + " cubes";
+	result.Duration = buddyFreeTimeSum / 10.0f;
+	m_TestResults.push_back(result);
+
+	m_RepeatedTests.clear();
 }
 
 void Application::RenderBuddyProgressBar() noexcept
 {
 	ImGui::Text("Memory: ");
 	ImGui::SameLine(0.0f, ImGui::GetStyle().ItemInnerSpacing.x);
-	float frac = (float)m_buddyUnusedMemory / (float)MAX_BLOCK;
+	const size_t capacity = m_buddyGrowable ? m_buddyHeap.getCapacity() : AppBuddyAllocator::MAX_BLOCK;
+	float frac = (float)m_buddyUnusedMemory / (float)capacity;
 	ImGui::ProgressBar(frac, ImVec2(0, 0));
 	ImGui::SameLine(0.0f, ImGui::GetStyle().ItemInnerSpacing.x);
-	ImGui::Text("%d / %d", m_buddyUnusedMemory, MAX_BLOCK);
+	ImGui::Text("%zu / %zu", m_buddyUnusedMemory, capacity);
+	if (m_buddyGrowable)
+		ImGui::Text("Arenas: %zu", m_buddyHeap.getArenaCount());
+
+	const AppBuddyAllocator::Stats& stats = m_buddyStats;
+	const float waste = stats.grantedBytes ? 100.0f * (float)(stats.grantedBytes - stats.requestedBytes) / (float)stats.grantedBytes : 0.0f;
+	ImGui::Text("Requested: %zu  Granted: %zu  Internal waste: %.1f%%", stats.requestedBytes, stats.grantedBytes, waste);
+	ImGui::Text("Largest free block: %zu  Fragmentation: %.3f", stats.largestFreeBlock, stats.fragmentation);
+	if (ImGui::BeginTable("Buddy levels", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+	{
+		ImGui::TableSetupColumn("Block size");
+		ImGui::TableSetupColumn("Live");
+		ImGui::TableSetupColumn("Free");
+		ImGui::TableSetupColumn("Deferred");
+		ImGui::TableSetupColumn("Requested");
+		ImGui::TableSetupColumn("Waste");
+		ImGui::TableHeadersRow();
+		for (const auto& level : stats.levels)
+		{
+			if (level.liveBlocks == 0 && level.freeBlocks == 0 && level.deferredBlocks == 0)
+				continue;
+			const size_t granted = level.liveBlocks * level.blockSize;
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu", level.blockSize);
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu", level.liveBlocks);
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu", level.freeBlocks);
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu", level.deferredBlocks);
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu", level.requestedBytes);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f%%", granted ? 100.0f * (float)(granted - level.requestedBytes) / (float)granted : 0.0f);
+		}
+		ImGui::EndTable();
+	}
 }
 
 void Application::StackAllocateObjects() noexcept
@@ -540,6 +1221,33 @@ void Application::PerformPoolAllocatorTest1() noexcept
 		result.Duration = deallocationTimeSum / 10.0f;
 		m_TestResults.push_back(result);
 
+		m_RepeatedTests.clear();
+
+		//Same objects through the bulk path.
+		allocationTimeSum = 0.0f;
+		deallocationTimeSum = 0.0f;
+		str1 = "Cube Pool bulk allocation: Test 1 - " + std::to_string(1000 * factor) + " cubes";
+		str2 = "Cube Pool bulk deallocation: Test 1 - " + std::to_string(1000 * factor) + " cubes";
+		for (uint64_t k{ 0u }; k < 10u; k++)
+		{
+			{
+				PROFILE_TEST(str1.c_str());
+				cubeAllocator.NewN(1000 * factor, cubes);
+			}
+			allocationTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+			{
+				PROFILE_TEST(str2.c_str());
+				cubeAllocator.DeleteN(cubes);
+			}
+			deallocationTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		}
+		result.Name = str1.c_str();
+		result.Duration = allocationTimeSum / 10.0f;
+		m_TestResults.push_back(result);
+		result.Name = str2.c_str();
+		result.Duration = deallocationTimeSum / 10.0f;
+		m_TestResults.push_back(result);
+
 		m_RepeatedTests.clear();
 		result = {};
 		allocationTimeSum = 0.0f;
@@ -624,6 +1332,33 @@ void Application::PerformPoolAllocatorTest2() noexcept
 		result.Duration = deallocationTimeSum / 10.0f;
 		m_TestResults.push_back(result);
 
+		m_RepeatedTests.clear();
+
+		//Same objects through the bulk path.
+		allocationTimeSum = 0.0f;
+		deallocationTimeSum = 0.0f;
+		str1 = "Pyramid Pool bulk allocation: Test 2 - " + std::to_string(1000 * factor) + " pyramids";
+		str2 = "Pyramid Pool bulk deallocation: Test 2 - " + std::to_string(1000 * factor) + " pyramids";
+		for (uint64_t k{ 0u }; k < 10u; k++)
+		{
+			{
+				PROFILE_TEST(str1.c_str());
+				pyramidAllocator.NewN(1000 * factor, pyramids);
+			}
+			allocationTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+			{
+				PROFILE_TEST(str2.c_str());
+				pyramidAllocator.DeleteN(pyramids);
+			}
+			deallocationTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		}
+		result.Name = str1.c_str();
+		result.Duration = allocationTimeSum / 10.0f;
+		m_TestResults.push_back(result);
+		result.Name = str2.c_str();
+		result.Duration = deallocationTimeSum / 10.0f;
+		m_TestResults.push_back(result);
+
 		m_RepeatedTests.clear();
 		result = {};
 		allocationTimeSum = 0.0f;
@@ -708,6 +1443,33 @@ void Application::PerformPoolAllocatorTest3() noexcept
 		result.Duration = deallocationTimeSum / 10.0f;
 		m_TestResults.push_back(result);
 
+		m_RepeatedTests.clear();
+
+		//Same objects through the bulk path.
+		allocationTimeSum = 0.0f;
+		deallocationTimeSum = 0.0f;
+		str1 = "Sphere Pool bulk allocation: Test 3 - " + std::to_string(1000 * factor) + " spheres";
+		str2 = "Sphere Pool bulk deallocation: Test 3 - " + std::to_string(1000 * factor) + " spheres";
+		for (uint64_t k{ 0u }; k < 10u; k++)
+		{
+			{
+				PROFILE_TEST(str1.c_str());
+				sphereAllocator.NewN(1000 * factor, spheres);
+			}
+			allocationTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+			{
+				PROFILE_TEST(str2.c_str());
+				sphereAllocator.DeleteN(spheres);
+			}
+			deallocationTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		}
+		result.Name = str1.c_str();
+		result.Duration = allocationTimeSum / 10.0f;
+		m_TestResults.push_back(result);
+		result.Name = str2.c_str();
+		result.Duration = deallocationTimeSum / 10.0f;
+		m_TestResults.push_back(result);
+
 		m_RepeatedTests.clear();
 		result = {};
 		allocationTimeSum = 0.0f;
@@ -745,3 +1507,388 @@ void Application::PerformPoolAllocatorTest3() noexcept
 		factor *= 10;
 	}
 }
+
+void Application::PerformConcurrentPoolAllocatorTest() noexcept
+{
+	m_TestResults.clear();
+	const uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	const uint32_t nrOfAllocations = 100000; //Per thread.
+	const uint32_t batchSize = 64;
+	ConcurrentPoolAllocator<Cube> cubeAllocator("Concurrent cube allocator", static_cast<uint64_t>(maxThreads) * batchSize);
+
+	//Every thread spawns a batch of cubes and deletes them again, the pool is shared by all of them.
+	auto work = [&]()
+	{
+		Cube* cubes[batchSize];
+		for (uint32_t i = 0; i < nrOfAllocations; i += batchSize)
+		{
+			for (uint32_t j = 0; j < batchSize; j++)
+				cubes[j] = cubeAllocator.New();
+			for (uint32_t j = 0; j < batchSize; j++)
+				cubeAllocator.Delete(cubes[j]);
+		}
+	};
+
+	//1, 2, 4, ... threads and finally every hardware thread.
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t nrOfThreads = 1u; nrOfThreads < maxThreads; nrOfThreads *= 2u)
+		threadCounts.push_back(nrOfThreads);
+	threadCounts.push_back(maxThreads);
+
+	for (const uint32_t nrOfThreads : threadCounts)
+	{
+		float timeSum = 0.0f;
+		std::string str = "Concurrent cube pool: " + std::to_string(nrOfThreads) + " threads x " + std::to_string(nrOfAllocations) + " New/Delete";
+		for (uint64_t i{ 0u }; i < 10u; i++)
+		{
+			{
+				PROFILE_TEST(str.c_str());
+				std::vector<std::thread> threads;
+				for (uint32_t t = 0; t < nrOfThreads; t++)
+					threads.emplace_back(work);
+				for (auto& thread : threads)
+					thread.join();
+			}
+			timeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		}
+
+		//Each thread does the same amount of work, so per-thread throughput is per-core throughput.
+		ProfileMetrics result = {};
+		result.Duration = timeSum / 10.0f;
+		const float millionOpsPerCore = result.Duration > 0.0f ? nrOfAllocations / (result.Duration * 1000.0f) : 0.0f;
+		char throughput[64];
+		snprintf(throughput, sizeof(throughput), " (%.1f M New+Delete/s per core)", millionOpsPerCore);
+		result.Name = str + throughput;
+		m_TestResults.push_back(result);
+
+		m_RepeatedTests.clear();
+	}
+}
+
+void Application::PerformGrowablePoolAllocatorTest() noexcept
+{
+	m_TestResults.clear();
+	const uint64_t nrOfCubes = 1000000;
+	std::vector<Cube*> cubes(nrOfCubes);
+
+	//Starts empty every round, so the growable pools pay for adding (and releasing) all their blocks.
+	auto runTest = [&](auto& cubeAllocator, const std::string& name)
+	{
+		float allocationTimeSum = 0.0f;
+		float deallocationTimeSum = 0.0f;
+		const std::string str1 = name + " allocation: " + std::to_string(nrOfCubes) + " cubes";
+		const std::string str2 = name + " deallocation: " + std::to_string(nrOfCubes) + " cubes";
+		for (uint64_t k{ 0u }; k < 10; k++)
+		{
+			{
+				PROFILE_TEST(str1.c_str());
+				for (uint64_t l{ 0u }; l < nrOfCubes; l++)
+				{
+					cubes[l] = cubeAllocator.New();
+				}
+			}
+			allocationTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+			{
+				PROFILE_TEST(str2.c_str());
+				for (uint64_t m{ 0u }; m < nrOfCubes; m++)
+				{
+					cubeAllocator.Delete(cubes[m]);
+				}
+			}
+			deallocationTimeSum += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		}
+		ProfileMetrics result = {};
+		result.Name = str1.c_str();
+		result.Duration = allocationTimeSum / 10.0f;
+		m_TestResults.push_back(result);
+		result.Name = str2.c_str();
+		result.Duration = deallocationTimeSum / 10.0f;
+		m_TestResults.push_back(result);
+		m_RepeatedTests.clear();
+	};
+
+	{
+		PoolAllocator<Cube> cubeAllocator("Cube Allocator", nrOfCubes);
+		runTest(cubeAllocator, "Fixed pool");
+	}
+	{
+		GrowablePoolAllocator<Cube> cubeAllocator("Cube Allocator", 64u * 1024u);
+		runTest(cubeAllocator, "Growable pool, 64 KiB blocks");
+	}
+	{
+		GrowablePoolAllocator<Cube> cubeAllocator("Cube Allocator", 2u * 1024u * 1024u);
+		runTest(cubeAllocator, "Growable pool, 2 MiB blocks");
+	}
+}
+
+void Application::PerformPoolSlotMapTest() noexcept
+{
+	m_TestResults.clear();
+	const uint32_t nrOfCubes = 1000000;
+	std::vector<Cube*> cubes(nrOfCubes);
+	std::vector<PoolHandle> handles(nrOfCubes);
+	PoolAllocator<Cube> cubeAllocator("Cube Allocator", nrOfCubes);
+	PoolSlotMap<Cube> cubeSlotMap("Cube Slot Map", nrOfCubes);
+
+	//Lookups go in a shuffled order, the way gameplay code follows references between entities.
+	std::vector<uint32_t> order(nrOfCubes);
+	std::iota(order.begin(), order.end(), 0u);
+	std::shuffle(order.begin(), order.end(), std::mt19937{ 42u });
+
+	float timeSums[6] = {};
+	const std::string names[6] = {
+		"Pool allocation: " + std::to_string(nrOfCubes) + " cubes",
+		"Slot map allocation: " + std::to_string(nrOfCubes) + " cubes",
+		"Pool lookup: " + std::to_string(nrOfCubes) + " random pointers",
+		"Slot map lookup: " + std::to_string(nrOfCubes) + " random handles",
+		"Pool deallocation: " + std::to_string(nrOfCubes) + " cubes",
+		"Slot map deallocation: " + std::to_string(nrOfCubes) + " cubes" };
+	uint64_t found = 0u;
+	for (uint64_t k{ 0u }; k < 10; k++)
+	{
+		{
+			PROFILE_TEST(names[0].c_str());
+			for (uint32_t i{ 0u }; i < nrOfCubes; i++)
+				cubes[i] = cubeAllocator.New();
+		}
+		timeSums[0] += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		{
+			PROFILE_TEST(names[1].c_str());
+			for (uint32_t i{ 0u }; i < nrOfCubes; i++)
+				handles[i] = cubeSlotMap.New();
+		}
+		timeSums[1] += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		{
+			PROFILE_TEST(names[2].c_str());
+			for (const uint32_t i : order)
+				found += cubes[i] != nullptr;
+		}
+		timeSums[2] += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		{
+			PROFILE_TEST(names[3].c_str());
+			for (const uint32_t i : order)
+				found += cubeSlotMap.Get(handles[i]) != nullptr;
+		}
+		timeSums[3] += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		{
+			PROFILE_TEST(names[4].c_str());
+			for (uint32_t i{ 0u }; i < nrOfCubes; i++)
+				cubeAllocator.Delete(cubes[i]);
+		}
+		timeSums[4] += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		{
+			PROFILE_TEST(names[5].c_str());
+			for (uint32_t i{ 0u }; i < nrOfCubes; i++)
+				cubeSlotMap.Delete(handles[i]);
+		}
+		timeSums[5] += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+	}
+
+	//Every handle is stale now, a raw pointer would dangle here. Half the slots get reused first,
+	//so the old handles of those are rejected by their generation rather than by an empty slot.
+	std::vector<PoolHandle> newHandles(nrOfCubes / 2);
+	for (PoolHandle& handle : newHandles)
+		handle = cubeSlotMap.New();
+	uint64_t nrOfRejected = 0u;
+	for (const PoolHandle handle : handles)
+		nrOfRejected += cubeSlotMap.Get(handle) == nullptr;
+	for (const PoolHandle handle : newHandles)
+		cubeSlotMap.Delete(handle);
+
+	ProfileMetrics result = {};
+	for (int i = 0; i < 6; i++)
+	{
+		result.Name = names[i];
+		result.Duration = timeSums[i] / 10.0f;
+		m_TestResults.push_back(result);
+	}
+	result.Duration = 0.0f;
+	result.Name = "Lookups that found their cube: " + std::to_string(found) + " of " + std::to_string(20ull * nrOfCubes);
+	m_TestResults.push_back(result);
+	result.Name = "Stale handles rejected after delete and slot reuse: " + std::to_string(nrOfRejected) + " of " + std::to_string(nrOfCubes);
+	m_TestResults.push_back(result);
+	m_RepeatedTests.clear();
+}
+
+void Application::PerformPoolIterationTest() noexcept
+{
+	m_TestResults.clear();
+	const uint32_t nrOfCubes = 1000000;
+	std::vector<Cube*> cubes(nrOfCubes);
+	PoolAllocator<Cube> cubeAllocator("Cube Allocator", nrOfCubes);
+	cubeAllocator.NewN(nrOfCubes, cubes);
+
+	//Free every other cube and make them again in shuffled order, so the pointer vector and the
+	//free list no longer follow the addresses, like after a while of gameplay.
+	std::shuffle(cubes.begin(), cubes.end(), std::mt19937{ 42u });
+	cubeAllocator.DeleteN(std::span<Cube* const>(cubes).subspan(0, nrOfCubes / 2));
+	cubeAllocator.NewN(nrOfCubes / 2, std::span<Cube*>(cubes).subspan(0, nrOfCubes / 2));
+
+	//Stands in for an update, reads the start of every cube. The vptr is never 0, so the threads
+	//never actually write to the shared counter.
+	std::atomic<uint64_t> nrOfNullCubes{ 0u };
+	auto update = [&](const Cube& cube)
+	{
+		uint64_t bytes;
+		std::memcpy(&bytes, &cube, sizeof(bytes));
+		if (bytes == 0u)
+			nrOfNullCubes.fetch_add(1u, std::memory_order_relaxed);
+	};
+
+	float timeSums[3] = {};
+	const std::string names[3] = {
+		"Pointer vector: " + std::to_string(nrOfCubes) + " cubes",
+		"ForEach (address order): " + std::to_string(nrOfCubes) + " cubes",
+		"ParallelForEach: " + std::to_string(nrOfCubes) + " cubes" };
+	for (uint64_t k{ 0u }; k < 10; k++)
+	{
+		{
+			PROFILE_TEST(names[0].c_str());
+			for (const Cube* pCube : cubes)
+				update(*pCube);
+		}
+		timeSums[0] += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		{
+			PROFILE_TEST(names[1].c_str());
+			cubeAllocator.ForEach(update);
+		}
+		timeSums[1] += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		{
+			PROFILE_TEST(names[2].c_str());
+			cubeAllocator.ParallelForEach(update);
+		}
+		timeSums[2] += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+	}
+
+	ProfileMetrics result = {};
+	for (int i = 0; i < 3; i++)
+	{
+		result.Name = names[i];
+		result.Duration = timeSums[i] / 10.0f;
+		m_TestResults.push_back(result);
+	}
+	m_RepeatedTests.clear();
+	cubeAllocator.DeleteN(cubes);
+}
+
+void Application::PerformSmallObjectAllocatorTest() noexcept
+{
+	m_TestResults.clear();
+	const uint32_t nrOfShapes = 30000;
+
+	//The same random mix of cubes, pyramids and spheres as stack test 3.
+	std::vector<int> randomInts(nrOfShapes);
+	std::mt19937 random{ 42u };
+	for (int& randomInt : randomInts)
+		randomInt = static_cast<int>(random() % 3u) + 1;
+	std::vector<Shape*> shapes(nrOfShapes);
+
+	//Every shape type needs its own pool, each sized for the case where every shape is of its type.
+	PoolAllocator<Cube> cubeAllocator("Cube Allocator", nrOfShapes);
+	PoolAllocator<Pyramid> pyramidAllocator("Pyramid Allocator", nrOfShapes);
+	PoolAllocator<Sphere> sphereAllocator("Sphere Allocator", nrOfShapes);
+	SmallObjectAllocator shapeAllocator("Shape Allocator");
+	uint64_t peakCapacity = 0u;
+
+	float timeSums[6] = {};
+	const std::string names[6] = {
+		"Three pools allocation: " + std::to_string(nrOfShapes) + " random shapes",
+		"Three pools deallocation: " + std::to_string(nrOfShapes) + " random shapes",
+		"Small object allocator allocation: " + std::to_string(nrOfShapes) + " random shapes",
+		"Small object allocator deallocation: " + std::to_string(nrOfShapes) + " random shapes",
+		"New allocation: " + std::to_string(nrOfShapes) + " random shapes",
+		"Delete deallocation: " + std::to_string(nrOfShapes) + " random shapes" };
+	for (uint64_t k{ 0u }; k < 10; k++)
+	{
+		{
+			PROFILE_TEST(names[0].c_str());
+			for (uint32_t i{ 0u }; i < nrOfShapes; i++)
+			{
+				switch (randomInts[i])
+				{
+				case 1: shapes[i] = cubeAllocator.New(); break;
+				case 2: shapes[i] = pyramidAllocator.New(); break;
+				default: shapes[i] = sphereAllocator.New(); break;
+				}
+			}
+		}
+		timeSums[0] += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		{
+			PROFILE_TEST(names[1].c_str());
+			for (uint32_t i{ 0u }; i < nrOfShapes; i++)
+			{
+				switch (randomInts[i])
+				{
+				case 1: cubeAllocator.Delete(static_cast<Cube*>(shapes[i])); break;
+				case 2: pyramidAllocator.Delete(static_cast<Pyramid*>(shapes[i])); break;
+				default: sphereAllocator.Delete(static_cast<Sphere*>(shapes[i])); break;
+				}
+			}
+		}
+		timeSums[1] += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		{
+			PROFILE_TEST(names[2].c_str());
+			for (uint32_t i{ 0u }; i < nrOfShapes; i++)
+			{
+				switch (randomInts[i])
+				{
+				case 1: shapes[i] = shapeAllocator.New<Cube>(); break;
+				case 2: shapes[i] = shapeAllocator.New<Pyramid>(); break;
+				default: shapes[i] = shapeAllocator.New<Sphere>(); break;
+				}
+			}
+		}
+		timeSums[2] += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		peakCapacity = std::max(peakCapacity, shapeAllocator.GetCapacity());
+		{
+			PROFILE_TEST(names[3].c_str());
+			for (uint32_t i{ 0u }; i < nrOfShapes; i++)
+			{
+				switch (randomInts[i])
+				{
+				case 1: shapeAllocator.Delete(static_cast<Cube*>(shapes[i])); break;
+				case 2: shapeAllocator.Delete(static_cast<Pyramid*>(shapes[i])); break;
+				default: shapeAllocator.Delete(static_cast<Sphere*>(shapes[i])); break;
+				}
+			}
+		}
+		timeSums[3] += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		{
+			PROFILE_TEST(names[4].c_str());
+			for (uint32_t i{ 0u }; i < nrOfShapes; i++)
+			{
+				switch (randomInts[i])
+				{
+				case 1: shapes[i] = DBG_NEW Cube; break;
+				case 2: shapes[i] = DBG_NEW Pyramid; break;
+				default: shapes[i] = DBG_NEW Sphere; break;
+				}
+			}
+		}
+		timeSums[4] += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+		{
+			PROFILE_TEST(names[5].c_str());
+			for (uint32_t i{ 0u }; i < nrOfShapes; i++)
+			{
+				delete shapes[i];
+			}
+		}
+		timeSums[5] += m_RepeatedTests[m_RepeatedTests.size() - 1].Duration;
+	}
+
+	ProfileMetrics result = {};
+	for (int i = 0; i < 6; i++)
+	{
+		result.Name = names[i];
+		result.Duration = timeSums[i] / 10.0f;
+		m_TestResults.push_back(result);
+	}
+	//What each approach has to set aside for this mix, in MiB.
+	const uint64_t poolsCapacity = cubeAllocator.GetCapacity() + pyramidAllocator.GetCapacity() + sphereAllocator.GetCapacity();
+	result.Duration = 0.0f;
+	result.Name = "Three pools capacity: " + std::to_string(poolsCapacity / (1024u * 1024u)) + " MiB";
+	m_TestResults.push_back(result);
+	result.Name = "Small object allocator peak capacity: " + std::to_string(peakCapacity / (1024u * 1024u)) + " MiB";
+	m_TestResults.push_back(result);
+	m_RepeatedTests.clear();
+}
@@ -4,6 +4,7 @@
 #include "Profiler.h"
 #include "PoolAllocator.h"
 #include "BuddyAllocator.hpp"
+#include "BuddyHeap.hpp"
 #include "ObjectClasses.h"
 
 #define TOKENPASTE(x, y) x ## y
@@ -30,6 +31,15 @@ private:
 	void NewDeallocateObjects(std::vector<T*>& objects, const uint64_t nrOfObjectsToDealloc) noexcept;
 	void BuddyAllocate() noexcept;
 	void BuddyDeallocate() noexcept;
+	void PerformBuddyAllocatorMergeTest() noexcept;
+	void PerformBuddyAllocatorContentionTest() noexcept;
+	void PerformBuddyAllocatorReallocTest() noexcept;
+	void PerformBuddyAllocatorDeferredCoalescingTest() noexcept;
+	void PerformBuddyMemoryResourceTest() noexcept;
+	void PerformHugePageTest() noexcept;
+	void PerformBuddyCompactionTest() noexcept;
+	void PerformBuddyAlignedTelemetryTest() noexcept;
+	void PerformSlabAllocatorTest() noexcept;
 	template<typename T>
 	void ResetPoolAllocator(PoolAllocator<T>& poolAllocator, std::vector<T*>& objects) noexcept;
 	template<typename T>
@@ -49,13 +59,20 @@ private:
 	void PerformPoolAllocatorTest1() noexcept;
 	void PerformPoolAllocatorTest2() noexcept;
 	void PerformPoolAllocatorTest3() noexcept;
+	void PerformConcurrentPoolAllocatorTest() noexcept;
+	void PerformGrowablePoolAllocatorTest() noexcept;
+	void PerformPoolSlotMapTest() noexcept;
+	void PerformPoolIterationTest() noexcept;
+	void PerformSmallObjectAllocatorTest() noexcept;
 private:
 	std::vector<ProfileMetrics> m_ProfileMetrics;
 	std::vector<ProfileMetrics> m_RepeatedTests;
 	std::vector<ProfileMetrics> m_TestResults;
 	bool m_Running;
 	std::unique_ptr<UI> m_pImGui;
-	BuddyAllocator m_buddyAllocator;
+	using AppBuddyAllocator = BuddyAllocator<9, 30>;
+	AppBuddyAllocator m_buddyAllocator;
+	BuddyHeap<9, 30> m_buddyHeap;
 	PoolAllocator<Cube> m_CubeAllocator = PoolAllocator<Cube>("Cube allocator");
 	std::vector<Cube*> m_pCubesPool;
 	std::vector<Cube*> m_pCubesNew;
@@ -64,13 +81,17 @@ private:
 
 	// Buddy Allocator Settings
 	std::vector<void*> m_buddyAllocations;
+	size_t m_buddyAllocatedCount = 0;
 	int m_buddyAllocationSize;
 	int m_buddyAllocationCount;
 	bool m_buddyEnabled;
 	bool m_buddyDealloc;
 	bool m_buddyAllocatorFull;
+	bool m_buddyGrowable = false;
+	bool m_buddyDeferredCoalescing = false;
 
 	size_t m_buddyUnusedMemory = 0;
+	AppBuddyAllocator::Stats m_buddyStats;
 };
 
 template<typename T>
@@ -89,10 +110,7 @@ void Application::PoolAllocateObjects(PoolAllocator<T>& poolAllocator, std::vect
 	std::string str = __FUNCTION__;
 	str.append(" '").append(poolAllocator.GetTag()).append("' (").append(std::to_string(nrOfObjectsToAlloc).c_str()).append(")");
 	PROFILE_SCOPE(str);
-	for (uint64_t i{ poolAllocator.GetEntityUsage() }; i < allocationLimit; i++)
-	{
-		objects[i] = poolAllocator.New();
-	}
+	poolAllocator.NewN(nrOfObjectsToAlloc, std::span<T*>(objects).subspan(poolAllocator.GetEntityUsage(), nrOfObjectsToAlloc));
 }
 
 template<typename T>
@@ -111,10 +129,7 @@ void Application::PoolDeallocateObjects(PoolAllocator<T>& poolAllocator, std::ve
 	str.append(" '").append(poolAllocator.GetTag()).append("' (").append(std::to_string(nrOfObjectsToDealloc).c_str()).append(")");
 	int end = static_cast<int>(start - nrOfObjectsToDealloc);
 	PROFILE_SCOPE(str);
-	for (int i{ start }; i > end; i--)
-	{
-		poolAllocator.Delete(objects[i]);
-	}
+	poolAllocator.DeleteN(std::span<T* const>(objects).subspan(end + 1, nrOfObjectsToDealloc));
 }
 
 template<typename T>
@@ -227,6 +242,26 @@ void Application::RenderPoolAllocatorSettingsPanel(PoolAllocator<T>& poolAllocat
 		{
 			PerformPoolAllocatorTest3();
 		}
+		if (ImGui::Button("Test 4 - Concurrent cubes (1..N threads)"))
+		{
+			PerformConcurrentPoolAllocatorTest();
+		}
+		if (ImGui::Button("Test 5 - Growable pool (1 000 000 cubes)"))
+		{
+			PerformGrowablePoolAllocatorTest();
+		}
+		if (ImGui::Button("Test 6 - Slot map handles vs pointers (1 000 000 cubes)"))
+		{
+			PerformPoolSlotMapTest();
+		}
+		if (ImGui::Button("Test 7 - Live object iteration (1 000 000 cubes)"))
+		{
+			PerformPoolIterationTest();
+		}
+		if (ImGui::Button("Test 8 - Random shapes, one small object allocator (30 000 shapes)"))
+		{
+			PerformSmallObjectAllocatorTest();
+		}
 
 		RenderPoolAllocatorProgressBar<T>(poolAllocator);
 	}
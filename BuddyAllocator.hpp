@@ -2,16 +2,84 @@
 
 #include <cstddef>
 #include <stdexcept>
-#include <bitset>
-
-constexpr static auto MAX = 30;
-constexpr static auto MIN = 9;
-constexpr static auto MAX_BLOCK = 1 << MAX;
-constexpr static auto MIN_BLOCK = 1 << MIN;
-constexpr static auto LEVELS = (MAX - MIN) + 1;
+#include <bit>
+#include <cstdint>
+#include <new>
+#include <algorithm>
+#include <cstring>
+#include "VirtualMemory.h"
 
+/// MinOrder and MaxOrder are the log2 of the smallest and largest block size,
+/// e.g. BuddyAllocator<9, 30> hands out 512 B .. 1 GiB blocks.
+template<int MinOrder, int MaxOrder>
 class BuddyAllocator
 {
+	static_assert(MinOrder >= 4, "Blocks must be large enough to hold a free-list node");
+	static_assert(MaxOrder >= MinOrder, "MaxOrder must not be smaller than MinOrder");
+	static_assert(MaxOrder - MinOrder < 32, "Too many levels for the free-bit tree");
+public:
+	constexpr static int MIN = MinOrder;
+	constexpr static int MAX = MaxOrder;
+	constexpr static size_t MAX_BLOCK = size_t{1} << MAX;
+	constexpr static size_t MIN_BLOCK = size_t{1} << MIN;
+	constexpr static int LEVELS = (MAX - MIN) + 1;
+	/// Granularity in which the arena is committed as blocks are handed out
+	constexpr static size_t COMMIT_GRANULE = MIN_BLOCK > (size_t{1} << 16) ? MIN_BLOCK : (size_t{1} << 16);
+	constexpr static size_t GRANULES = MAX_BLOCK > COMMIT_GRANULE ? MAX_BLOCK / COMMIT_GRANULE : 1;
+	/// One bit per buddy pair (free(left) XOR free(right)), i.e. one per splittable node
+	constexpr static size_t PAIRS = (size_t{1} << (LEVELS - 1)) - 1;
+	constexpr static size_t MIN_BLOCKS = MAX_BLOCK / MIN_BLOCK;
+
+	struct Stats
+	{
+		struct Level
+		{
+			size_t blockSize = 0;
+			size_t liveBlocks = 0;
+			size_t freeBlocks = 0;
+			size_t deferredBlocks = 0; // Freed, but not merged yet
+			size_t requestedBytes = 0; // Of the live blocks, granted is liveBlocks * blockSize
+		};
+		size_t requestedBytes = 0;
+		size_t grantedBytes = 0;
+		size_t freeBytes = 0;
+		size_t largestFreeBlock = 0;
+		/// 1 - largestFreeBlock / freeBytes: 0 when all free memory is one block
+		float fragmentation = 0.0f;
+		Level levels[LEVELS] = {};
+	};
+private:
+	constexpr static size_t PAIR_WORDS = PAIRS / 64 + 1;
+	constexpr static size_t GRANULE_WORDS = (GRANULES + 63) / 64;
+	constexpr static size_t METADATA_BYTES = (PAIR_WORDS + GRANULE_WORDS) * sizeof(uint64_t) + MIN_BLOCKS;
+
+	/// Free-block index (enableFreeBlockIndex): per level a bitmap with a bit per block that is on
+	/// the free list, and above it summary tiers with a bit per non-zero word of the tier below
+	constexpr static int INDEX_TIERS = 6; // 64^6 bits covers 32 levels
+	struct IndexLayout
+	{
+		size_t offsets[LEVELS][INDEX_TIERS];
+		int tiers[LEVELS];
+		size_t words;
+	};
+	constexpr static IndexLayout INDEX_LAYOUT = [] {
+		IndexLayout layout{};
+		for (int lvl = 0; lvl < LEVELS; ++lvl)
+		{
+			size_t bits = size_t{1} << lvl;
+			int tier = 0;
+			do
+			{
+				const size_t words = (bits + 63) / 64;
+				layout.offsets[lvl][tier++] = layout.words;
+				layout.words += words;
+				bits = words;
+			} while (bits > 1);
+			layout.tiers[lvl] = tier;
+		}
+		return layout;
+	}();
+	constexpr static size_t INDEX_BYTES = INDEX_LAYOUT.words * sizeof(uint64_t);
 private:
 	std::byte* mem;
 	struct Node
@@ -21,152 +89,689 @@ private:
 	};
 private:
 	Node* firstFree[LEVELS] = {nullptr};
-	std::bitset<(1 << LEVELS) - 1> freeBits = {true};
+	uint32_t nonEmptyLevels = 0; // Bit n is set while firstFree[n] has a block
+	// Tree state lives in a separate page-aligned allocation to keep the object small
+	uint64_t* pairBits = nullptr;
+	uint64_t* committed = nullptr;
+	// Level + 1 of the allocated block starting at each MIN_BLOCK, 0 if none starts there
+	uint8_t* blockLevels = nullptr;
+	// Only allocated by enableFreeBlockIndex
+	uint64_t* freeIndex = nullptr;
 	size_t unusedMemory = MAX_BLOCK;
+	// Telemetry per level
+	size_t liveBlocks[LEVELS] = {0};
+	size_t freeBlocks[LEVELS] = {0};
+	size_t requestedBytes[LEVELS] = {0};
+	// Deferred coalescing: freed blocks wait here, still marked as in use in the tree
+	bool deferredCoalescing = false;
+	Node* deferred[LEVELS] = {nullptr};
+	size_t deferredBlocks[LEVELS] = {0};
+	PageBacking pageBacking = PageBacking::Small;
 public:
-	BuddyAllocator()
+	/// Only reserves the address space, pages are committed as blocks are handed out.
+	/// The arena is aligned to MAX_BLOCK, so every block is aligned to its own size.
+	/// PageBacking::Huge maps the whole arena up front with huge pages where the OS grants
+	/// them (see VirtualMemory::AllocateAligned), and those pages are never decommitted
+	explicit BuddyAllocator(PageBacking backing = PageBacking::Small)
 	{
-		this->mem = new std::byte[MAX_BLOCK]();
-		firstFree[0] = reinterpret_cast<Node*>(mem); // Its prev and next are auto nullptr
+		this->pairBits = static_cast<uint64_t*>(VirtualMemory::Reserve(METADATA_BYTES));
+		if (backing == PageBacking::Huge)
+			this->mem = static_cast<std::byte*>(VirtualMemory::AllocateAligned(MAX_BLOCK, MAX_BLOCK, backing, &pageBacking));
+		else
+			this->mem = static_cast<std::byte*>(VirtualMemory::ReserveAligned(MAX_BLOCK, MAX_BLOCK));
+		if (!this->pairBits || !this->mem || !VirtualMemory::Commit(this->pairBits, METADATA_BYTES))
+		{
+			releaseMemory();
+			throw std::bad_alloc();
+		}
+		this->committed = this->pairBits + PAIR_WORDS;
+		this->blockLevels = reinterpret_cast<uint8_t*>(this->committed + GRANULE_WORDS);
+		if (backing == PageBacking::Huge)
+			std::fill_n(committed, GRANULE_WORDS, ~uint64_t{0});
+		if (!commit(mem, sizeof(Node)))
+		{
+			releaseMemory();
+			throw std::bad_alloc();
+		}
+		pushFree(reinterpret_cast<Node*>(mem), 0);
 	};
 	~BuddyAllocator()
 	{
-		delete[] this->mem;
+		releaseMemory();
 	};
+	BuddyAllocator(const BuddyAllocator&) = delete;
+	BuddyAllocator& operator=(const BuddyAllocator&) = delete;
 
 	[[nodiscard]]
 	void* alloc(size_t size)
 	{
 		if (size == 0 || size > MAX_BLOCK)
 			return nullptr;
-		auto lvl = levelFromSize(size);
-		Node* node = getNodeAtLevel(lvl);
-		if (!node)
+		return allocAtLevel(levelFromSize(size), size);
+	};
+
+	/// Blocks are aligned to their own size, so this just picks a level whose block size
+	/// is at least the alignment. Free with free(ptr) or free(ptr, size)
+	[[nodiscard]]
+	void* alloc_aligned(size_t size, size_t alignment)
+	{
+		if (size == 0 || size > MAX_BLOCK || !std::has_single_bit(alignment) || alignment > MAX_BLOCK)
 			return nullptr;
+		return allocAtLevel(levelFromSize(size > alignment ? size : alignment), size);
+	}
 
-		unusedMemory -= pow2Size(size);
-		firstFree[lvl] = node->next;
-		return reinterpret_cast<void*>(node);
-	};
+	/// Grows in place while the block is a left half whose right buddy is free, shrinks in
+	/// place by handing the tail halves back. Only falls back to alloc + copy + free when
+	/// growing in place isn't possible. Returns nullptr (and keeps ptr) if that fails too
+	[[nodiscard]]
+	void* realloc(void* ptr, size_t oldSize, size_t newSize)
+	{
+		if (!ptr)
+			return alloc(newSize);
+		if (newSize == 0)
+		{
+			free(ptr, oldSize);
+			return nullptr;
+		}
+		if (newSize > MAX_BLOCK)
+			return nullptr;
 
+		const int oldLvl = blockLevels[blockIndex(ptr)] - 1;
+		const int newLvl = levelFromSize(newSize);
+		Node* node = static_cast<Node*>(ptr);
+		if (newLvl > oldLvl)
+			shrinkInPlace(node, oldLvl, newLvl);
+		else if (newLvl < oldLvl && !growInPlace(node, oldLvl, newLvl))
+		{
+			void* newPtr = alloc(newSize);
+			if (!newPtr)
+				return nullptr;
+			std::memcpy(newPtr, ptr, oldSize < newSize ? oldSize : newSize);
+			freeAtLevel(ptr, oldLvl, oldSize);
+			return newPtr;
+		}
+		trackFree(oldLvl, 1, oldSize);
+		trackAlloc(newLvl, 1, newSize);
+		return ptr;
+	}
+
+	/// Like alloc, but takes the lowest free block that starts below limit, nullptr if there is
+	/// none. O(levels) with enableFreeBlockIndex, otherwise it walks the free lists
+	[[nodiscard]]
+	void* allocBelow(size_t size, const void* limit)
+	{
+		if (size == 0 || size > MAX_BLOCK)
+			return nullptr;
+		const int lvl = levelFromSize(size);
+		Node* lowest = nullptr;
+		int lowestLevel = 0;
+		for (int from = lvl; from >= 0; --from)
+		{
+			Node* node = lowestFree(from);
+			if (node && (const std::byte*)node < (const std::byte*)limit && (!lowest || node < lowest))
+			{
+				lowest = node;
+				lowestLevel = from;
+			}
+		}
+		if (!lowest)
+			return nullptr;
+
+		removeFree(lowest, lowestLevel);
+		Node* block = splitBlock(lowest, lowestLevel, lvl);
+		if (!block)
+			return nullptr;
+		if (!commit(block, sizeOfLevel(lvl)))
+		{
+			mergeNode(block, lvl);
+			return nullptr;
+		}
+		blockLevels[blockIndex(block)] = static_cast<uint8_t>(lvl + 1);
+		unusedMemory -= sizeOfLevel(lvl);
+		trackAlloc(lvl, 1, size);
+		return block;
+	}
+
+	/// Allocates up to count blocks of size into out and returns how many it got.
+	/// Whole free blocks are carved into leaves in one go instead of splitting per block
+	size_t alloc_bulk(size_t size, size_t count, void** out)
+	{
+		if (size == 0 || size > MAX_BLOCK)
+			return 0;
+		const int lvl = levelFromSize(size);
+		size_t done = 0;
+		for (; done < count && deferred[lvl]; ++done)
+		{
+			out[done] = popDeferred(lvl);
+			blockLevels[blockIndex(out[done])] = static_cast<uint8_t>(lvl + 1);
+		}
+		unusedMemory -= done * sizeOfLevel(lvl);
+		trackAlloc(lvl, done, done * size);
+
+		while (done < count)
+		{
+			// The largest block whose leaves are all needed, and the closest one that is free
+			const int remainingOrder = static_cast<int>(std::bit_width(count - done)) - 1;
+			const int wanted = remainingOrder < lvl ? lvl - remainingOrder : 0;
+			int from = closestFreeLevel(lvl);
+			if (from < 0 && coalesce())
+				from = closestFreeLevel(lvl);
+			if (from < 0)
+				break;
+
+			const int top = from > wanted ? from : wanted;
+			Node* block = takeBlock(from, top);
+			if (!block)
+				break;
+			if (!commit(block, sizeOfLevel(top)))
+			{
+				mergeNode(block, top);
+				break;
+			}
+
+			// Every pair bit inside a block taken whole is 0, which already means "both in use"
+			const size_t nrOfLeaves = size_t{1} << (lvl - top);
+			for (size_t i = 0; i < nrOfLeaves; ++i)
+			{
+				std::byte* leaf = (std::byte*)block + i * sizeOfLevel(lvl);
+				blockLevels[blockIndex(leaf)] = static_cast<uint8_t>(lvl + 1);
+				out[done++] = leaf;
+			}
+			unusedMemory -= sizeOfLevel(top);
+			trackAlloc(lvl, nrOfLeaves, nrOfLeaves * size);
+		}
+		return done;
+	}
+
+	/// Frees count blocks of the same size and level. ptrs is sorted and reused as scratch space.
+	/// Buddies that are both in the batch are merged without touching the free lists,
+	/// level by level, and only what's left goes through the regular merge
+	void free_bulk(void** ptrs, size_t count, size_t size)
+	{
+		count = std::remove(ptrs, ptrs + count, nullptr) - ptrs;
+		if (count == 0)
+			return;
+		std::sort(ptrs, ptrs + count);
+
+		int lvl = blockLevels[blockIndex(ptrs[0])] - 1;
+		for (size_t i = 0; i < count; ++i)
+			blockLevels[blockIndex(ptrs[i])] = 0;
+		unusedMemory += count * sizeOfLevel(lvl);
+		trackFree(lvl, count, count * size);
+		if (deferredCoalescing)
+		{
+			for (size_t i = 0; i < count; ++i)
+				pushDeferred(static_cast<Node*>(ptrs[i]), lvl);
+			return;
+		}
+
+		for (; count > 0; --lvl)
+		{
+			size_t parents = 0;
+			for (size_t i = 0; i < count; ++i)
+			{
+				std::byte* node = static_cast<std::byte*>(ptrs[i]);
+				const bool firstHalf = lvl > 0 && ((node - this->mem) & sizeOfLevel(lvl)) == 0;
+				if (firstHalf && i + 1 < count && ptrs[i + 1] == node + sizeOfLevel(lvl))
+				{
+					// Both halves go from used to free, so their pair bit stays 0
+					ptrs[parents++] = node;
+					++i;
+				}
+				else
+				{
+					mergeNode(reinterpret_cast<Node*>(node), lvl);
+				}
+			}
+			count = parents;
+		}
+	}
+
+	/// For callers that still know the size they asked for. The level still comes from the
+	/// side table, since an over-aligned block sits above the level its size maps to
 	void free(void* ptr, size_t size)
 	{
 		if (!ptr) return; // freeing nullptr
 
-		int lvl = levelFromSize(size);
+		freeAtLevel(ptr, blockLevels[blockIndex(ptr)] - 1, size);
+	};
 
-		Node* freed = (Node*)ptr;
+	/// Looks the block's level up in the side table, so any pointer from alloc can be freed
+	void free(void* ptr)
+	{
+		if (!ptr) return;
 
-		mergeNode(freed, lvl);
+		freeAtLevel(ptr, blockLevels[blockIndex(ptr)] - 1, 0);
+	}
 
-		unusedMemory += pow2Size(size);
-	};
+	/// Size of the block backing ptr, at least what was asked for
+	size_t usable_size(const void* ptr) const
+	{
+		return sizeOfLevel(blockLevels[blockIndex(ptr)] - 1);
+	}
 
-	void reset()
+	/// Frees everything. With decommit the arena's pages are handed back to the OS as well,
+	/// unless the arena got huge pages.
+	/// blockLevels is left as is, stale entries are never read and alloc overwrites them
+	void reset(bool decommit = false)
 	{
-		freeBits[0] = true;
+		std::fill_n(pairBits, PAIR_WORDS, uint64_t{0});
+
+		if (decommit && pageBacking == PageBacking::Small)
+		{
+			VirtualMemory::Decommit(mem, MAX_BLOCK);
+			std::fill_n(committed, GRANULE_WORDS, uint64_t{0});
+			if (!commit(mem, sizeof(Node)))
+				throw std::bad_alloc();
+		}
 
 		for (auto& n : firstFree) n = nullptr;
-		firstFree[0] = reinterpret_cast<Node*>(mem);
-		firstFree[0][0] = Node{nullptr, nullptr};
+		nonEmptyLevels = 0;
+		std::fill_n(liveBlocks, LEVELS, size_t{0});
+		std::fill_n(freeBlocks, LEVELS, size_t{0});
+		std::fill_n(requestedBytes, LEVELS, size_t{0});
+		for (auto& n : deferred) n = nullptr;
+		std::fill_n(deferredBlocks, LEVELS, size_t{0});
+		if (freeIndex)
+			std::fill_n(freeIndex, INDEX_LAYOUT.words, uint64_t{0});
+		pushFree(reinterpret_cast<Node*>(mem), 0);
 		unusedMemory = MAX_BLOCK;
 	}
 
+	/// Keeps an index of the free blocks of every level, so allocBelow finds the lowest one in
+	/// O(levels) instead of walking the free lists. Costs about 2^LEVELS / 8 bytes and a couple of
+	/// bit updates per free-list change. Returns false if the index couldn't be allocated
+	bool enableFreeBlockIndex()
+	{
+		if (freeIndex)
+			return true;
+		freeIndex = static_cast<uint64_t*>(VirtualMemory::Reserve(INDEX_BYTES));
+		if (!freeIndex || !VirtualMemory::Commit(freeIndex, INDEX_BYTES))
+		{
+			VirtualMemory::Release(freeIndex, INDEX_BYTES);
+			freeIndex = nullptr;
+			return false;
+		}
+		for (int lvl = 0; lvl < LEVELS; ++lvl)
+		{
+			for (Node* node = firstFree[lvl]; node; node = node->next)
+				indexSet(node, lvl);
+		}
+		return true;
+	}
+
 	size_t getUnusedMemory() { return unusedMemory; }
-private:
-	static size_t pow2Size(size_t size)
+
+	/// Frees stop at a per-level list instead of merging, and the next alloc of that size
+	/// takes the block back without splitting. Merging happens in coalesce(), which alloc
+	/// calls by itself when nothing free is big enough. Turning it off coalesces
+	void setDeferredCoalescing(bool enabled)
+	{
+		deferredCoalescing = enabled;
+		if (!enabled)
+			coalesce();
+	}
+	bool isDeferringCoalescing() const { return deferredCoalescing; }
+
+	/// Merges every deferred block into the tree. Returns false if there was nothing to merge
+	bool coalesce()
+	{
+		bool merged = false;
+		for (int lvl = LEVELS - 1; lvl >= 0; --lvl)
+		{
+			while (deferred[lvl])
+			{
+				mergeNode(popDeferred(lvl), lvl);
+				merged = true;
+			}
+		}
+		return merged;
+	}
+
+	Stats getStats() const
 	{
-		size_t ret = MIN_BLOCK;
-		for (; ret < size; ret <<= 1);
-		return ret;
+		Stats stats;
+		for (int lvl = 0; lvl < LEVELS; ++lvl)
+		{
+			stats.levels[lvl] = {sizeOfLevel(lvl), liveBlocks[lvl], freeBlocks[lvl], deferredBlocks[lvl], requestedBytes[lvl]};
+			stats.requestedBytes += requestedBytes[lvl];
+			stats.grantedBytes += liveBlocks[lvl] * sizeOfLevel(lvl);
+		}
+		stats.freeBytes = unusedMemory;
+		uint32_t freeLevels = nonEmptyLevels;
+		for (int lvl = 0; lvl < LEVELS; ++lvl)
+			freeLevels |= deferred[lvl] ? uint32_t{1} << lvl : 0;
+		stats.largestFreeBlock = freeLevels ? sizeOfLevel(std::countr_zero(freeLevels)) : 0;
+		stats.fragmentation = stats.freeBytes ? 1.0f - (float)stats.largestFreeBlock / (float)stats.freeBytes : 0.0f;
+		return stats;
 	}
-	static int levelFromSize(size_t size)
+
+	const std::byte* getBase() const { return mem; }
+	/// What the OS granted, PageBacking::Small if huge pages were asked for but not available
+	PageBacking getPageBacking() const { return pageBacking; }
+	bool isEmpty() const { return unusedMemory == MAX_BLOCK; }
+
+	constexpr static size_t pow2Size(size_t size)
+	{
+		return size <= MIN_BLOCK ? MIN_BLOCK : std::bit_ceil(size);
+	}
+	constexpr static int levelFromSize(size_t size)
 	{
 		if (size <= MIN_BLOCK) return LEVELS - 1;
-		size = pow2Size(size);
-		size >>= MIN; // size /= MIN_BLOCK
-		int level;
-		for (level = LEVELS - 1; size > 1; --level)
-			size >>= 1;
-		return level;
+		return MAX - static_cast<int>(std::bit_width(size - 1));
+	}
+
+	constexpr static size_t sizeOfLevel(int level)
+	{
+		return MAX_BLOCK >> level;
+	}
+private:
+	void* allocAtLevel(int lvl, size_t requested)
+	{
+		Node* node = nullptr;
+		if (deferred[lvl])
+		{
+			// Deferred blocks are still committed and marked as in use
+			node = popDeferred(lvl);
+		}
+		else
+		{
+			node = getNodeAtLevel(lvl);
+			if (!node && coalesce())
+				node = getNodeAtLevel(lvl);
+			if (!node)
+				return nullptr;
+			if (!commit(node, sizeOfLevel(lvl)))
+			{
+				mergeNode(node, lvl);
+				return nullptr;
+			}
+		}
+
+		blockLevels[blockIndex(node)] = static_cast<uint8_t>(lvl + 1);
+		unusedMemory -= sizeOfLevel(lvl);
+		trackAlloc(lvl, 1, requested);
+		return reinterpret_cast<void*>(node);
 	}
 
-	static size_t sizeOfLevel(int level)
+	/// requested is 0 when the caller didn't pass a size
+	void freeAtLevel(void* ptr, int lvl, size_t requested)
 	{
-		return MAX_BLOCK / (1 << level);
+		blockLevels[blockIndex(ptr)] = 0;
+		if (deferredCoalescing)
+			pushDeferred(static_cast<Node*>(ptr), lvl);
+		else
+			mergeNode(static_cast<Node*>(ptr), lvl);
+		unusedMemory += sizeOfLevel(lvl);
+		trackFree(lvl, 1, requested);
 	}
 
-	/// Splits nodes until a node is available at the requested level
-	Node* getNodeAtLevel(int level)
+	void trackAlloc(int lvl, size_t count, size_t requested)
 	{
-		if (this->firstFree[level])
+		liveBlocks[lvl] += count;
+		requestedBytes[lvl] += requested;
+	}
+
+	/// Size-less frees don't know what was requested and take away the level's average
+	void trackFree(int lvl, size_t count, size_t requested)
+	{
+		if (requested == 0)
+			requested = liveBlocks[lvl] ? requestedBytes[lvl] / liveBlocks[lvl] * count : 0;
+		liveBlocks[lvl] -= count;
+		if (requested > requestedBytes[lvl])
+			requested = requestedBytes[lvl];
+		requestedBytes[lvl] = liveBlocks[lvl] ? requestedBytes[lvl] - requested : 0;
+	}
+
+	void shrinkInPlace(Node* node, int oldLvl, int newLvl)
+	{
+		// The head keeps being used, so the tail can't merge with anything
+		for (int lvl = oldLvl + 1; lvl <= newLvl; ++lvl)
 		{
-			Node* retNode = this->firstFree[level];
-			freeBits[indexOf(retNode, level)] = false;
-			return retNode;
+			Node* tail = (Node*)((std::byte*)node + sizeOfLevel(lvl));
+			togglePair(tail, lvl);
+			pushFree(tail, lvl);
 		}
-		if (level == 0)
-			return nullptr;
-		//throw std::runtime_error("Not enough space to allocate");
+		blockLevels[blockIndex(node)] = static_cast<uint8_t>(newLvl + 1);
+		unusedMemory += sizeOfLevel(oldLvl) - sizeOfLevel(newLvl);
+	}
 
-	// We have to split
-		Node* splitNode = getNodeAtLevel(level - 1);
-		if (!splitNode)
-			return nullptr;
+	bool growInPlace(Node* node, int oldLvl, int newLvl)
+	{
+		const size_t offset = (std::byte*)node - this->mem;
+		if (offset % sizeOfLevel(newLvl) != 0)
+			return false; // Not the first half all the way up
+		// node is in use, so a set pair bit means its right buddy is free as a whole
+		for (int lvl = oldLvl; lvl > newLvl; --lvl)
+			if (!testBit(pairBits, pairOf(node, lvl)))
+				return false;
+		if (!commit(node, sizeOfLevel(newLvl)))
+			return false;
 
-		firstFree[level - 1] = splitNode->next;
-		Node* first = splitNode;
-		Node* second = (Node*)((std::byte*)first + sizeOfLevel(level));
-		first[0] = Node{nullptr, second};
-		second[0] = Node{nullptr, nullptr};
-		freeBits[indexOf(second, level)] = true;
-		firstFree[level] = first;
+		for (int lvl = oldLvl; lvl > newLvl; --lvl)
+		{
+			removeFree((Node*)((std::byte*)node + sizeOfLevel(lvl)), lvl);
+			togglePair(node, lvl);
+		}
+		blockLevels[blockIndex(node)] = static_cast<uint8_t>(newLvl + 1);
+		unusedMemory -= sizeOfLevel(newLvl) - sizeOfLevel(oldLvl);
+		return true;
+	}
 
-		return first;
+	size_t blockIndex(const void* ptr) const
+	{
+		return static_cast<size_t>((const std::byte*)ptr - this->mem) >> MIN;
 	}
 
-	size_t indexOf(Node* node, int level) const
+	/// Takes the smallest free block at or above the requested level and splits it down
+	Node* getNodeAtLevel(int level)
 	{
-		size_t inLvl = ((std::byte*)node - this->mem) / sizeOfLevel(level);
-		return ((1 << level) - 1) + inLvl;
+		const int from = closestFreeLevel(level);
+		if (from < 0)
+			return nullptr;
+		return takeBlock(from, level);
 	}
 
-	void mergeNode(Node* node, int level)
+	/// Deepest level <= level that has a free block, -1 if there is none
+	int closestFreeLevel(int level) const
+	{
+		const uint32_t candidates = nonEmptyLevels & ((uint32_t{2} << level) - 1);
+		return static_cast<int>(std::bit_width(candidates)) - 1;
+	}
+
+	/// Pops a free block from level from and splits it down to level
+	Node* takeBlock(int from, int level)
+	{
+		return splitBlock(popFree(from), from, level);
+	}
+
+	/// node was just taken off the free list of level from
+	Node* splitBlock(Node* node, int from, int level)
 	{
-		const size_t index = indexOf(node, level);
-		freeBits[index] = true;
+		if (from > 0)
+			togglePair(node, from);
 
+		// Keep the first half, put the second half on the free list of the level below
+		for (; from < level; ++from)
+		{
+			Node* second = (Node*)((std::byte*)node + sizeOfLevel(from + 1));
+			if (!commit(second, sizeof(Node)))
+			{
+				mergeNode(node, from);
+				return nullptr;
+			}
+			togglePair(second, from + 1);
+			pushFree(second, from + 1);
+		}
+		return node;
+	}
+
+	void pushFree(Node* node, int level)
+	{
+		node[0] = Node{nullptr, firstFree[level]};
 		if (firstFree[level]) firstFree[level]->prev = node;
-		node[0] = Node{nullptr, firstFree[level] == node ? nullptr : firstFree[level]};
 		firstFree[level] = node;
+		nonEmptyLevels |= uint32_t{1} << level;
+		++freeBlocks[level];
+		if (freeIndex)
+			indexSet(node, level);
+	}
 
-		if (level == 0)
+	Node* popFree(int level)
+	{
+		Node* node = firstFree[level];
+		--freeBlocks[level];
+		firstFree[level] = node->next;
+		if (firstFree[level])
+			firstFree[level]->prev = nullptr;
+		else
+			nonEmptyLevels &= ~(uint32_t{1} << level);
+		if (freeIndex)
+			indexClear(node, level);
+		return node;
+	}
+
+	void removeFree(Node* node, int level)
+	{
+		--freeBlocks[level];
+		if (node->prev) node->prev->next = node->next;
+		else firstFree[level] = node->next;
+		if (node->next) node->next->prev = node->prev;
+		if (!firstFree[level])
+			nonEmptyLevels &= ~(uint32_t{1} << level);
+		if (freeIndex)
+			indexClear(node, level);
+	}
+
+	/// Sets the block's bit, and the summary bits above it that go from 0 to 1
+	void indexSet(const Node* node, int level)
+	{
+		size_t index = static_cast<size_t>((const std::byte*)node - this->mem) >> (MAX - level);
+		for (int tier = 0; tier < INDEX_LAYOUT.tiers[level]; ++tier)
 		{
-			return;
+			uint64_t& word = freeIndex[INDEX_LAYOUT.offsets[level][tier] + index / 64];
+			const bool wasEmpty = word == 0;
+			word |= uint64_t{1} << (index % 64);
+			if (!wasEmpty)
+				return;
+			index /= 64;
+		}
+	}
+
+	/// Clears the block's bit, and the summary bits above it whose word became 0
+	void indexClear(const Node* node, int level)
+	{
+		size_t index = static_cast<size_t>((const std::byte*)node - this->mem) >> (MAX - level);
+		for (int tier = 0; tier < INDEX_LAYOUT.tiers[level]; ++tier)
+		{
+			uint64_t& word = freeIndex[INDEX_LAYOUT.offsets[level][tier] + index / 64];
+			word &= ~(uint64_t{1} << (index % 64));
+			if (word != 0)
+				return;
+			index /= 64;
+		}
+	}
+
+	/// Lowest free block of the level, nullptr if there is none
+	Node* lowestFree(int level) const
+	{
+		if (!freeIndex)
+		{
+			Node* lowest = nullptr;
+			for (Node* node = firstFree[level]; node; node = node->next)
+				lowest = !lowest || node < lowest ? node : lowest;
+			return lowest;
+		}
+		// The top tier is a single word, follow the lowest set bit down to the block
+		size_t index = 0;
+		for (int tier = INDEX_LAYOUT.tiers[level] - 1; tier >= 0; --tier)
+		{
+			const uint64_t word = freeIndex[INDEX_LAYOUT.offsets[level][tier] + index];
+			if (word == 0)
+				return nullptr;
+			index = index * 64 + std::countr_zero(word);
 		}
+		return (Node*)(this->mem + (index << (MAX - level)));
+	}
 
-		const size_t buddyIndex = (index % 2 == 0) ? index - 1 : index + 1;
-		if (freeBits[buddyIndex])
+	void pushDeferred(Node* node, int level)
+	{
+		node->next = deferred[level];
+		deferred[level] = node;
+		++deferredBlocks[level];
+	}
+
+	Node* popDeferred(int level)
+	{
+		Node* node = deferred[level];
+		deferred[level] = node->next;
+		--deferredBlocks[level];
+		return node;
+	}
+
+	/// Commits every granule overlapping [ptr, ptr + size) that isn't committed yet
+	bool commit(void* ptr, size_t size)
+	{
+		const size_t offset = (std::byte*)ptr - this->mem;
+		const size_t last = (offset + size - 1) / COMMIT_GRANULE;
+		const size_t granuleSize = COMMIT_GRANULE < MAX_BLOCK ? COMMIT_GRANULE : MAX_BLOCK;
+		size_t granule = offset / COMMIT_GRANULE;
+		while (granule <= last)
 		{
-			const size_t relativePtr = (buddyIndex - ((1 << level) - 1)) * sizeOfLevel(level);
-			Node* buddy = (Node*)(this->mem + relativePtr);
-			while (firstFree[level] == node || firstFree[level] == buddy)
+			if (testBit(committed, granule))
 			{
-				firstFree[level] = firstFree[level]->next;
-				if (firstFree[level]) firstFree[level]->prev = nullptr;
+				++granule;
+				continue;
 			}
-			if (buddy->prev) buddy->prev->next = buddy->next;
-			if (buddy->next) buddy->next->prev = buddy->prev;
-			if (node->prev) node->prev->next = node->next;
-			if (node->next) node->next->prev = node->prev;
+			size_t end = granule + 1;
+			while (end <= last && !testBit(committed, end))
+				++end;
+			if (!VirtualMemory::Commit(this->mem + granule * COMMIT_GRANULE, (end - granule) * granuleSize))
+				return false;
+			for (; granule < end; ++granule)
+				committed[granule / 64] |= uint64_t{1} << (granule % 64);
+		}
+		return true;
+	}
 
-			Node* parent = node < buddy ? node : buddy;
+	void releaseMemory()
+	{
+		VirtualMemory::Release(this->mem, MAX_BLOCK);
+		VirtualMemory::Release(this->pairBits, METADATA_BYTES);
+		VirtualMemory::Release(this->freeIndex, INDEX_BYTES);
+	}
 
-			if (firstFree[level - 1]) firstFree[level - 1]->prev = parent;
-			parent[0] = Node{nullptr, firstFree[level - 1]};
-			firstFree[level - 1] = parent;
+	static bool testBit(const uint64_t* bits, size_t index)
+	{
+		return (bits[index / 64] >> (index % 64)) & 1;
+	}
+
+	/// Flips the pair bit shared by node and its buddy, returns the new value.
+	/// 1 means exactly one of the two is free, 0 that both are free or both are in use
+	bool togglePair(Node* node, int level)
+	{
+		const size_t pair = pairOf(node, level);
+		pairBits[pair / 64] ^= uint64_t{1} << (pair % 64);
+		return testBit(pairBits, pair);
+	}
+
+	size_t pairOf(const Node* node, int level) const
+	{
+		const size_t inLvl = ((const std::byte*)node - this->mem) >> (MAX - level);
+		return ((size_t{1} << (level - 1)) - 1) + (inLvl >> 1);
+	}
+
+	/// Frees the node and merges it with its buddy for as long as the buddy is free
+	void mergeNode(Node* node, int level)
+	{
+		while (level > 0 && !togglePair(node, level))
+		{
+			Node* buddy = (Node*)(this->mem + (((std::byte*)node - this->mem) ^ sizeOfLevel(level)));
+			removeFree(buddy, level);
 
-			mergeNode(parent, level - 1);
+			node = node < buddy ? node : buddy;
+			--level;
 		}
+		pushFree(node, level);
 	}
 };
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include "BuddyAllocator.hpp"
+
+/// Chains BuddyAllocator arenas so a peak doesn't have to fit in a single arena.
+/// A new arena is added when none of the existing ones can serve an allocation,
+/// and arenas that stay empty for longer than the idle period are given back to
+/// the OS by releaseIdleArenas(). The first arena is always kept.
+/// Arenas are aligned to MAX_BLOCK, so the owner of a pointer is found by masking it.
+template<int MinOrder, int MaxOrder>
+class BuddyHeap
+{
+public:
+	using Arena = BuddyAllocator<MinOrder, MaxOrder>;
+	using Clock = std::chrono::steady_clock;
+	constexpr static size_t MIN_BLOCK = Arena::MIN_BLOCK;
+	constexpr static size_t MAX_BLOCK = Arena::MAX_BLOCK;
+private:
+	struct ArenaEntry
+	{
+		Arena arena;
+		Clock::time_point emptySince = Clock::now();
+	};
+public:
+	explicit BuddyHeap(Clock::duration idlePeriod = std::chrono::seconds(5), size_t maxArenas = 16)
+		: idlePeriod(idlePeriod), maxArenas(maxArenas)
+	{
+		if (!addArena())
+			throw std::bad_alloc();
+	}
+	BuddyHeap(const BuddyHeap&) = delete;
+	BuddyHeap& operator=(const BuddyHeap&) = delete;
+
+	[[nodiscard]]
+	void* alloc(size_t size)
+	{
+		if (size == 0 || size > Arena::MAX_BLOCK)
+			return nullptr;
+		return allocFromArenas([size](Arena& arena) { return arena.alloc(size); });
+	}
+
+	[[nodiscard]]
+	void* alloc_aligned(size_t size, size_t alignment)
+	{
+		if (size == 0 || size > Arena::MAX_BLOCK || !std::has_single_bit(alignment) || alignment > Arena::MAX_BLOCK)
+			return nullptr;
+		return allocFromArenas([size, alignment](Arena& arena) { return arena.alloc_aligned(size, alignment); });
+	}
+
+	/// Fills from the current arena, then the others, then from new arenas
+	size_t alloc_bulk(size_t size, size_t count, void** out)
+	{
+		if (size == 0 || size > Arena::MAX_BLOCK)
+			return 0;
+		size_t done = arenas[current]->arena.alloc_bulk(size, count, out);
+		for (size_t i = 0; i < arenas.size() && done < count; ++i)
+		{
+			if (i != current)
+				done += arenas[i]->arena.alloc_bulk(size, count - done, out + done);
+		}
+		while (done < count && arenas.size() < maxArenas && addArena())
+		{
+			current = arenas.size() - 1;
+			done += arenas[current]->arena.alloc_bulk(size, count - done, out + done);
+		}
+		return done;
+	}
+
+	/// Sorting groups the pointers by arena, each run is handed to its arena's free_bulk
+	void free_bulk(void** ptrs, size_t count, size_t size)
+	{
+		count = std::remove(ptrs, ptrs + count, nullptr) - ptrs;
+		std::sort(ptrs, ptrs + count);
+		for (size_t begin = 0; begin < count;)
+		{
+			ArenaEntry& entry = *ownerOf(ptrs[begin]);
+			const std::byte* end = entry.arena.getBase() + Arena::MAX_BLOCK;
+			size_t runEnd = begin + 1;
+			while (runEnd < count && static_cast<std::byte*>(ptrs[runEnd]) < end)
+				++runEnd;
+			entry.arena.free_bulk(ptrs + begin, runEnd - begin, size);
+			if (entry.arena.isEmpty())
+				entry.emptySince = Clock::now();
+			begin = runEnd;
+		}
+	}
+
+	/// Tries the owning arena first (in place or within the arena), then any other arena
+	[[nodiscard]]
+	void* realloc(void* ptr, size_t oldSize, size_t newSize)
+	{
+		if (!ptr)
+			return alloc(newSize);
+		if (newSize == 0)
+		{
+			free(ptr, oldSize);
+			return nullptr;
+		}
+		if (void* newPtr = ownerOf(ptr)->arena.realloc(ptr, oldSize, newSize))
+			return newPtr;
+
+		void* newPtr = alloc(newSize);
+		if (!newPtr)
+			return nullptr;
+		std::memcpy(newPtr, ptr, oldSize < newSize ? oldSize : newSize);
+		free(ptr, oldSize);
+		return newPtr;
+	}
+
+	void free(void* ptr, size_t size)
+	{
+		if (!ptr) return;
+		ArenaEntry& entry = *ownerOf(ptr);
+		entry.arena.free(ptr, size);
+		if (entry.arena.isEmpty())
+			entry.emptySince = Clock::now();
+	}
+
+	void free(void* ptr)
+	{
+		if (!ptr) return;
+		ArenaEntry& entry = *ownerOf(ptr);
+		entry.arena.free(ptr);
+		if (entry.arena.isEmpty())
+			entry.emptySince = Clock::now();
+	}
+
+	size_t usable_size(const void* ptr) const
+	{
+		return ownerOf(ptr)->arena.usable_size(ptr);
+	}
+
+	/// Resets every arena, the extra ones then go away after the idle period
+	void reset(bool decommit = false)
+	{
+		const Clock::time_point now = Clock::now();
+		for (auto& entry : arenas)
+		{
+			entry->arena.reset(decommit);
+			entry->emptySince = now;
+		}
+		current = 0;
+	}
+
+	/// Call once per frame or so. Releases arenas that have been empty for the whole idle period
+	void releaseIdleArenas(Clock::time_point now = Clock::now())
+	{
+		for (size_t i = arenas.size() - 1; i > 0; --i)
+		{
+			ArenaEntry& entry = *arenas[i];
+			if (!entry.arena.isEmpty() || now - entry.emptySince < idlePeriod)
+				continue;
+
+			owners.erase(reinterpret_cast<uintptr_t>(entry.arena.getBase()));
+			arenas.erase(arenas.begin() + i);
+			if (current >= i)
+				current = current > 0 ? current - 1 : 0;
+		}
+	}
+
+	void setIdlePeriod(Clock::duration period) { idlePeriod = period; }
+
+	/// See BuddyAllocator::setDeferredCoalescing, applies to arenas added later as well
+	void setDeferredCoalescing(bool enabled)
+	{
+		deferredCoalescing = enabled;
+		for (auto& entry : arenas)
+			entry->arena.setDeferredCoalescing(enabled);
+	}
+
+	void coalesce()
+	{
+		for (auto& entry : arenas)
+			entry->arena.coalesce();
+	}
+	size_t getArenaCount() const { return arenas.size(); }
+	size_t getCapacity() const { return arenas.size() * Arena::MAX_BLOCK; }
+	size_t getUnusedMemory() const
+	{
+		size_t unused = 0;
+		for (const auto& entry : arenas)
+			unused += entry->arena.getUnusedMemory();
+		return unused;
+	}
+
+	/// Sums the arenas. The largest free block is the largest in any arena
+	typename Arena::Stats getStats() const
+	{
+		typename Arena::Stats stats;
+		for (const auto& entry : arenas)
+		{
+			const typename Arena::Stats arenaStats = entry->arena.getStats();
+			stats.requestedBytes += arenaStats.requestedBytes;
+			stats.grantedBytes += arenaStats.grantedBytes;
+			stats.freeBytes += arenaStats.freeBytes;
+			stats.largestFreeBlock = std::max(stats.largestFreeBlock, arenaStats.largestFreeBlock);
+			for (int lvl = 0; lvl < Arena::LEVELS; ++lvl)
+			{
+				stats.levels[lvl].blockSize = arenaStats.levels[lvl].blockSize;
+				stats.levels[lvl].liveBlocks += arenaStats.levels[lvl].liveBlocks;
+				stats.levels[lvl].freeBlocks += arenaStats.levels[lvl].freeBlocks;
+				stats.levels[lvl].deferredBlocks += arenaStats.levels[lvl].deferredBlocks;
+				stats.levels[lvl].requestedBytes += arenaStats.levels[lvl].requestedBytes;
+			}
+		}
+		stats.fragmentation = stats.freeBytes ? 1.0f - (float)stats.largestFreeBlock / (float)stats.freeBytes : 0.0f;
+		return stats;
+	}
+private:
+	/// Tries the current arena, then the others, then a new one if there's room for it
+	template<typename AllocFn>
+	void* allocFromArenas(AllocFn allocFn)
+	{
+		if (void* ptr = allocFn(arenas[current]->arena))
+			return ptr;
+
+		for (size_t i = 0; i < arenas.size(); ++i)
+		{
+			if (i == current)
+				continue;
+			if (void* ptr = allocFn(arenas[i]->arena))
+			{
+				current = i;
+				return ptr;
+			}
+		}
+
+		if (arenas.size() >= maxArenas || !addArena())
+			return nullptr;
+		current = arenas.size() - 1;
+		return allocFn(arenas[current]->arena);
+	}
+
+	bool addArena()
+	{
+		std::unique_ptr<ArenaEntry> entry;
+		try
+		{
+			entry = std::make_unique<ArenaEntry>();
+		}
+		catch (const std::bad_alloc&)
+		{
+			return false;
+		}
+		entry->arena.setDeferredCoalescing(deferredCoalescing);
+		owners[reinterpret_cast<uintptr_t>(entry->arena.getBase())] = entry.get();
+		arenas.push_back(std::move(entry));
+		return true;
+	}
+
+	ArenaEntry* ownerOf(const void* ptr) const
+	{
+		const uintptr_t base = reinterpret_cast<uintptr_t>(ptr) & ~(uintptr_t{Arena::MAX_BLOCK} - 1);
+		return owners.at(base);
+	}
+private:
+	std::vector<std::unique_ptr<ArenaEntry>> arenas;
+	std::unordered_map<uintptr_t, ArenaEntry*> owners;
+	size_t current = 0;
+	Clock::duration idlePeriod;
+	size_t maxArenas;
+	bool deferredCoalescing = false;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <memory_resource>
+#include <new>
+#include "BuddyAllocator.hpp"
+
+/// Lets std::pmr containers draw from a buddy heap (BuddyAllocator, BuddyHeap or
+/// ConcurrentBuddyAllocator). The heap is not owned and has to outlive the resource.
+/// Blocks are aligned to their own size, so alignment only bumps small blocks up a level
+template<typename Heap>
+class BuddyMemoryResource : public std::pmr::memory_resource
+{
+public:
+	explicit BuddyMemoryResource(Heap& heap) noexcept : heap(heap) {}
+	BuddyMemoryResource(const BuddyMemoryResource&) = delete;
+	BuddyMemoryResource& operator=(const BuddyMemoryResource&) = delete;
+
+	Heap& getHeap() const noexcept { return heap; }
+private:
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		void* ptr = heap.alloc_aligned(bytes ? bytes : 1, alignment);
+		if (!ptr)
+			throw std::bad_alloc();
+		return ptr;
+	}
+
+	void do_deallocate(void* ptr, size_t bytes, size_t alignment) override
+	{
+		// Same level alloc_aligned picked
+		if (bytes < alignment)
+			bytes = alignment;
+		heap.free(ptr, bytes ? bytes : 1);
+	}
+
+	/// Memory can go back through any resource that wraps the same heap
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		const auto* resource = dynamic_cast<const BuddyMemoryResource*>(&other);
+		return resource && &resource->heap == &heap;
+	}
+private:
+	Heap& heap;
+};
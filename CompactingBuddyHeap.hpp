@@ -0,0 +1,197 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <algorithm>
+#include <vector>
+#include "BuddyAllocator.hpp"
+
+/// Index into the handle table of a CompactingBuddyHeap. The generation tells a
+/// handle apart from later ones that reuse the same slot
+struct BuddyHandle
+{
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+
+	explicit operator bool() const { return index != UINT32_MAX; }
+	bool operator==(const BuddyHandle&) const = default;
+};
+
+/// BuddyAllocator whose blocks are reached through handles, so they can be moved.
+/// compact() moves unpinned blocks into free blocks at lower addresses, a bit per call,
+/// which lets the freed space at the top merge back into large blocks.
+/// get() is only valid until the next compact(); pin() keeps a block in place until unpin()
+template<int MinOrder, int MaxOrder>
+class CompactingBuddyHeap
+{
+public:
+	using Arena = BuddyAllocator<MinOrder, MaxOrder>;
+	using Clock = std::chrono::steady_clock;
+	/// Called after a block has been copied to its new address
+	using RelocationCallback = std::function<void(BuddyHandle handle, void* pOld, void* pNew)>;
+private:
+	struct Entry
+	{
+		void* ptr = nullptr; // nullptr while the slot is free
+		size_t size = 0;
+		uint32_t generation = 0;
+		uint32_t pinCount = 0;
+	};
+public:
+	/// The arena keeps a free-block index, so finding a target for a move is O(levels)
+	CompactingBuddyHeap()
+	{
+		if (!arena.enableFreeBlockIndex())
+			throw std::bad_alloc();
+	}
+	CompactingBuddyHeap(const CompactingBuddyHeap&) = delete;
+	CompactingBuddyHeap& operator=(const CompactingBuddyHeap&) = delete;
+
+	/// Returns an empty handle when the arena is full; compact() and try again
+	[[nodiscard]]
+	BuddyHandle alloc(size_t size)
+	{
+		void* ptr = arena.alloc(size);
+		if (!ptr)
+			return {};
+
+		uint32_t index;
+		if (freeSlots.empty())
+		{
+			index = static_cast<uint32_t>(entries.size());
+			entries.emplace_back();
+		}
+		else
+		{
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		Entry& entry = entries[index];
+		entry.ptr = ptr;
+		entry.size = size;
+		entry.pinCount = 0;
+		return {index, entry.generation};
+	}
+
+	void free(BuddyHandle handle)
+	{
+		if (!isValid(handle))
+			return;
+		Entry& entry = entries[handle.index];
+		arena.free(entry.ptr, entry.size);
+		entry.ptr = nullptr;
+		++entry.generation;
+		freeSlots.push_back(handle.index);
+	}
+
+	/// Current address, nullptr for a stale handle
+	void* get(BuddyHandle handle) const
+	{
+		return isValid(handle) ? entries[handle.index].ptr : nullptr;
+	}
+
+	/// Keeps the block where it is until the matching unpin()
+	void* pin(BuddyHandle handle)
+	{
+		if (!isValid(handle))
+			return nullptr;
+		++entries[handle.index].pinCount;
+		return entries[handle.index].ptr;
+	}
+
+	void unpin(BuddyHandle handle)
+	{
+		if (isValid(handle) && entries[handle.index].pinCount > 0)
+			--entries[handle.index].pinCount;
+	}
+
+	bool isValid(BuddyHandle handle) const
+	{
+		return handle.index < entries.size() && entries[handle.index].ptr && entries[handle.index].generation == handle.generation;
+	}
+
+	void setRelocationCallback(RelocationCallback callback) { relocationCallback = std::move(callback); }
+
+	/// Moves blocks into the lowest free block below them, highest blocks first, until the
+	/// budget runs out. A pass over all blocks can span several calls. Returns the bytes moved,
+	/// which can be 0 before the heap is settled when a call's budget ends at a pass boundary;
+	/// isSettled() tells when a whole pass found nothing to move
+	size_t compact(Clock::duration budget)
+	{
+		const Clock::time_point deadline = Clock::now() + budget;
+		arena.coalesce();
+
+		size_t movedBytes = 0;
+		// Handles looked at since the clock was last read, across passes
+		uint32_t sinceClockCheck = 0;
+		for (;;)
+		{
+			if (passCursor == pass.size())
+			{
+				settled = !passMoved;
+				beginPass();
+				if (settled || Clock::now() >= deadline)
+					break;
+				sinceClockCheck = 0;
+			}
+
+			bool moved = false;
+			const BuddyHandle handle = pass[passCursor++];
+			if (isValid(handle) && entries[handle.index].pinCount == 0)
+			{
+				Entry& entry = entries[handle.index];
+				if (void* newPtr = arena.allocBelow(entry.size, entry.ptr))
+				{
+					std::memcpy(newPtr, entry.ptr, entry.size);
+					arena.free(entry.ptr, entry.size);
+					if (relocationCallback)
+						relocationCallback(handle, entry.ptr, newPtr);
+					entry.ptr = newPtr;
+					movedBytes += entry.size;
+					passMoved = true;
+					moved = true;
+				}
+			}
+			// A move can be a large copy, so the clock is read after every one. Reading it costs
+			// about as much as skipping a few handles, so otherwise only every 16
+			if (moved || ++sinceClockCheck == 16)
+			{
+				sinceClockCheck = 0;
+				if (Clock::now() >= deadline)
+					break;
+			}
+		}
+		return movedBytes;
+	}
+
+	size_t getUnusedMemory() { return arena.getUnusedMemory(); }
+	typename Arena::Stats getStats() const { return arena.getStats(); }
+	/// True once a whole pass found nothing to move
+	bool isSettled() const { return settled; }
+	size_t getHandleCount() const { return entries.size() - freeSlots.size(); }
+private:
+	/// Live blocks, highest address first
+	void beginPass()
+	{
+		pass.clear();
+		for (uint32_t i = 0; i < entries.size(); ++i)
+		{
+			if (entries[i].ptr)
+				pass.push_back({i, entries[i].generation});
+		}
+		std::sort(pass.begin(), pass.end(), [this](BuddyHandle a, BuddyHandle b) { return entries[a.index].ptr > entries[b.index].ptr; });
+		passCursor = 0;
+		passMoved = false;
+	}
+private:
+	Arena arena;
+	std::vector<Entry> entries;
+	std::vector<uint32_t> freeSlots;
+	std::vector<BuddyHandle> pass;
+	size_t passCursor = 0;
+	bool passMoved = true; // The first call starts a pass instead of stopping
+	bool settled = false;
+	RelocationCallback relocationCallback;
+};
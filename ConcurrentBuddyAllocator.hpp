@@ -0,0 +1,161 @@
+#pragma once
+
+#include <mutex>
+#include "BuddyAllocator.hpp"
+
+/// BuddyAllocator that can be shared between threads.
+/// The tree itself is guarded by one lock; a split or merge walks several levels,
+/// so locking per level would mean taking most of the locks anyway. Contention is
+/// kept off the lock by ThreadCache, which keeps a small magazine of blocks for the
+/// smallest (hottest) levels and only refills/flushes half a magazine at a time.
+template<int MinOrder, int MaxOrder>
+class ConcurrentBuddyAllocator
+{
+public:
+	using Heap = BuddyAllocator<MinOrder, MaxOrder>;
+	constexpr static int CACHED_LEVELS = Heap::LEVELS < 4 ? Heap::LEVELS : 4;
+	constexpr static uint32_t MAGAZINE_SIZE = 32;
+
+	/// Owned by a single thread. Blocks cached here still count as allocated in the heap
+	class ThreadCache
+	{
+	public:
+		explicit ThreadCache(ConcurrentBuddyAllocator& allocator) : allocator(allocator) {}
+		~ThreadCache() { flush(); }
+		ThreadCache(const ThreadCache&) = delete;
+		ThreadCache& operator=(const ThreadCache&) = delete;
+
+		[[nodiscard]]
+		void* alloc(size_t size)
+		{
+			if (size == 0 || size > Heap::MAX_BLOCK)
+				return nullptr;
+			const int slot = slotOf(Heap::levelFromSize(size));
+			if (slot < 0)
+				return allocator.alloc(size);
+
+			Magazine& magazine = magazines[slot];
+			if (magazine.count == 0)
+				refill(magazine, Heap::sizeOfLevel(Heap::LEVELS - 1 - slot));
+			return magazine.count ? magazine.blocks[--magazine.count] : nullptr;
+		}
+
+		void free(void* ptr, size_t size)
+		{
+			if (!ptr) return;
+			const int slot = slotOf(Heap::levelFromSize(size));
+			if (slot < 0)
+			{
+				allocator.free(ptr, size);
+				return;
+			}
+
+			Magazine& magazine = magazines[slot];
+			if (magazine.count == MAGAZINE_SIZE)
+				drain(magazine, MAGAZINE_SIZE / 2, Heap::sizeOfLevel(Heap::LEVELS - 1 - slot));
+			magazine.blocks[magazine.count++] = ptr;
+		}
+
+		/// Takes the lock to look the size up, realloc on another thread can resize a block in place.
+		/// Pass the size to stay off the lock
+		void free(void* ptr)
+		{
+			if (!ptr) return;
+			size_t size;
+			{
+				std::lock_guard<std::mutex> lock(allocator.mutex);
+				size = allocator.heap.usable_size(ptr);
+			}
+			free(ptr, size);
+		}
+
+		/// Hands every cached block back to the shared heap
+		void flush()
+		{
+			for (int slot = 0; slot < CACHED_LEVELS; ++slot)
+				drain(magazines[slot], magazines[slot].count, Heap::sizeOfLevel(Heap::LEVELS - 1 - slot));
+		}
+	private:
+		struct Magazine
+		{
+			void* blocks[MAGAZINE_SIZE];
+			uint32_t count = 0;
+		};
+
+		/// Slot 0 caches the smallest blocks, -1 means the level isn't cached
+		static int slotOf(int level)
+		{
+			const int slot = Heap::LEVELS - 1 - level;
+			return slot < CACHED_LEVELS ? slot : -1;
+		}
+
+		void refill(Magazine& magazine, size_t blockSize)
+		{
+			std::lock_guard<std::mutex> lock(allocator.mutex);
+			magazine.count += static_cast<uint32_t>(allocator.heap.alloc_bulk(blockSize, MAGAZINE_SIZE / 2 - magazine.count, magazine.blocks + magazine.count));
+		}
+
+		void drain(Magazine& magazine, uint32_t nrOfBlocks, size_t blockSize)
+		{
+			if (nrOfBlocks == 0)
+				return;
+			magazine.count -= nrOfBlocks;
+			std::lock_guard<std::mutex> lock(allocator.mutex);
+			allocator.heap.free_bulk(magazine.blocks + magazine.count, nrOfBlocks, blockSize);
+		}
+	private:
+		ConcurrentBuddyAllocator& allocator;
+		Magazine magazines[CACHED_LEVELS];
+	};
+
+public:
+	ConcurrentBuddyAllocator() = default;
+	ConcurrentBuddyAllocator(const ConcurrentBuddyAllocator&) = delete;
+	ConcurrentBuddyAllocator& operator=(const ConcurrentBuddyAllocator&) = delete;
+
+	[[nodiscard]]
+	void* alloc(size_t size)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return heap.alloc(size);
+	}
+
+	/// Free these here, not through a ThreadCache: its magazines go by size, not by level
+	[[nodiscard]]
+	void* alloc_aligned(size_t size, size_t alignment)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return heap.alloc_aligned(size, alignment);
+	}
+
+	[[nodiscard]]
+	void* realloc(void* ptr, size_t oldSize, size_t newSize)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return heap.realloc(ptr, oldSize, newSize);
+	}
+
+	void free(void* ptr, size_t size)
+	{
+		if (!ptr) return;
+		std::lock_guard<std::mutex> lock(mutex);
+		heap.free(ptr, size);
+	}
+
+	void free(void* ptr)
+	{
+		if (!ptr) return;
+		std::lock_guard<std::mutex> lock(mutex);
+		heap.free(ptr);
+	}
+
+	/// Includes blocks parked in thread caches as used
+	size_t getUnusedMemory()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return heap.getUnusedMemory();
+	}
+private:
+	std::mutex mutex;
+	Heap heap;
+};
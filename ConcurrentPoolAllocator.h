@@ -0,0 +1,176 @@
+#pragma once
+#include "pch.h"
+#include "VirtualMemory.h"
+#include <atomic>
+
+//Same overlay as PoolChunk, but the link is a 32-bit index so it fits in the tagged head.
+template<typename T>
+union ConcurrentPoolChunk
+{
+	alignas(alignof(T))
+	std::byte data[sizeof(T)];
+	//Index + 1 of the next free chunk, 0 ends the list.
+	uint32_t nextFreeChunk;
+};
+
+//PoolAllocator that New and Delete can be called on from any thread.
+//Recycled chunks are kept in a Treiber stack. The head packs the index of the top chunk with
+//a tag that every push changes, so a pop that raced with a pop + push of the same chunk (ABA)
+//fails its compare-exchange instead of corrupting the list. Chunks that were never used are
+//handed out with an atomic bump index, like the lazy free list of PoolAllocator.
+template<class T>
+class ConcurrentPoolAllocator
+{
+public:
+	ConcurrentPoolAllocator(const char* tag, const uint64_t entityCapacity = 1000000u);
+	~ConcurrentPoolAllocator();
+	ConcurrentPoolAllocator(const ConcurrentPoolAllocator&) = delete;
+	ConcurrentPoolAllocator& operator=(const ConcurrentPoolAllocator&) = delete;
+	template<typename... Arguments>
+	T* New(Arguments&&... args);
+	void Delete(T* pData);
+	[[nodiscard]] const char* GetTag() const noexcept;
+	[[nodiscard]] const uint64_t GetUsage() const noexcept;
+	[[nodiscard]] const uint64_t GetCapacity() const noexcept;
+	[[nodiscard]] const uint64_t GetEntityUsage() const noexcept;
+	[[nodiscard]] const uint64_t GetEntityCapacity() const noexcept;
+
+private:
+	[[nodiscard]] static constexpr uint64_t PackHead(const uint32_t chunk, const uint32_t tag) noexcept;
+	[[nodiscard]] static constexpr uint32_t ChunkOf(const uint64_t head) noexcept;
+	[[nodiscard]] static constexpr uint32_t TagOf(const uint64_t head) noexcept;
+
+	ConcurrentPoolChunk<T>* m_pMemoryPool;
+	const char* m_Tag;
+	uint64_t m_MaxEntities;
+	uint64_t m_MappedBytes;
+	//Each hot atomic gets its own cache line so the threads don't also fight over false sharing.
+	//Low 32 bits: index + 1 of the top free chunk (0 = empty), high 32 bits: tag.
+	alignas(64) std::atomic<uint64_t> m_Head;
+	alignas(64) std::atomic<uint64_t> m_NextUnusedChunk;
+	alignas(64) std::atomic<uint64_t> m_NrOfEntities;
+};
+
+template<class T>
+ConcurrentPoolAllocator<T>::ConcurrentPoolAllocator(const char* tag, const uint64_t entityCapacity)
+	: m_Tag{ tag },
+	  m_MaxEntities{ entityCapacity },
+	  m_MappedBytes{ sizeof(ConcurrentPoolChunk<T>) * entityCapacity },
+	  m_Head{ 0u },
+	  m_NextUnusedChunk{ 0u },
+	  m_NrOfEntities{ 0u }
+{
+	assert(entityCapacity < UINT32_MAX && "Chunk indices are 32-bit");
+	//Committed up front, committing on demand would need a lock. Pages still only get
+	//physical memory when the bump index first reaches them.
+	m_pMemoryPool = static_cast<ConcurrentPoolChunk<T>*>(VirtualMemory::AllocateAligned(m_MappedBytes, alignof(ConcurrentPoolChunk<T>), PageBacking::Small));
+	if (!m_pMemoryPool)
+	{
+		throw std::bad_alloc();
+	}
+}
+
+template<class T>
+ConcurrentPoolAllocator<T>::~ConcurrentPoolAllocator()
+{
+	VirtualMemory::Release(m_pMemoryPool, m_MappedBytes);
+	m_pMemoryPool = nullptr;
+}
+
+template<class T>
+template<typename ...Arguments>
+T* ConcurrentPoolAllocator<T>::New(Arguments&&... args)
+{
+	ConcurrentPoolChunk<T>* pPoolChunk = nullptr;
+	uint64_t head = m_Head.load(std::memory_order_acquire);
+	while (ChunkOf(head) != 0)
+	{
+		ConcurrentPoolChunk<T>* pTop = std::addressof(m_pMemoryPool[ChunkOf(head) - 1]);
+		//pTop may already have been popped and handed out by another thread, then this reads
+		//a stale link, but the tag has changed as well and the exchange below fails.
+		const uint32_t next = std::atomic_ref<uint32_t>(pTop->nextFreeChunk).load(std::memory_order_relaxed);
+		if (m_Head.compare_exchange_weak(head, PackHead(next, TagOf(head)), std::memory_order_acquire, std::memory_order_acquire))
+		{
+			pPoolChunk = pTop;
+			break;
+		}
+	}
+
+	if (!pPoolChunk)
+	{
+		//Free list is empty, take the next chunk that was never used.
+		uint64_t index = m_NextUnusedChunk.load(std::memory_order_relaxed);
+		do
+		{
+			if (index == m_MaxEntities)
+				return nullptr;
+		} while (!m_NextUnusedChunk.compare_exchange_weak(index, index + 1, std::memory_order_relaxed));
+		pPoolChunk = std::addressof(m_pMemoryPool[index]);
+	}
+
+	m_NrOfEntities.fetch_add(1, std::memory_order_relaxed);
+	return new(std::addressof(pPoolChunk->data))T(std::forward<Arguments>(args)...);
+}
+
+template<class T>
+void ConcurrentPoolAllocator<T>::Delete(T* pData)
+{
+	pData->~T();
+	ConcurrentPoolChunk<T>* pPoolChunk = reinterpret_cast<ConcurrentPoolChunk<T>*>(pData);
+	const uint32_t chunk = static_cast<uint32_t>(pPoolChunk - m_pMemoryPool) + 1;
+
+	uint64_t head = m_Head.load(std::memory_order_relaxed);
+	do
+	{
+		std::atomic_ref<uint32_t>(pPoolChunk->nextFreeChunk).store(ChunkOf(head), std::memory_order_relaxed);
+	} while (!m_Head.compare_exchange_weak(head, PackHead(chunk, TagOf(head) + 1), std::memory_order_release, std::memory_order_relaxed));
+	m_NrOfEntities.fetch_sub(1, std::memory_order_relaxed);
+}
+
+template<class T>
+constexpr uint64_t ConcurrentPoolAllocator<T>::PackHead(const uint32_t chunk, const uint32_t tag) noexcept
+{
+	return (static_cast<uint64_t>(tag) << 32) | chunk;
+}
+
+template<class T>
+constexpr uint32_t ConcurrentPoolAllocator<T>::ChunkOf(const uint64_t head) noexcept
+{
+	return static_cast<uint32_t>(head);
+}
+
+template<class T>
+constexpr uint32_t ConcurrentPoolAllocator<T>::TagOf(const uint64_t head) noexcept
+{
+	return static_cast<uint32_t>(head >> 32);
+}
+
+template<typename T>
+const char* ConcurrentPoolAllocator<T>::GetTag() const noexcept
+{
+	return m_Tag;
+}
+
+template<class T>
+const uint64_t ConcurrentPoolAllocator<T>::GetUsage() const noexcept
+{
+	return GetEntityUsage() * sizeof(ConcurrentPoolChunk<T>);
+}
+
+template<class T>
+const uint64_t ConcurrentPoolAllocator<T>::GetCapacity() const noexcept
+{
+	return m_MaxEntities * sizeof(ConcurrentPoolChunk<T>);
+}
+
+template<class T>
+const uint64_t ConcurrentPoolAllocator<T>::GetEntityUsage() const noexcept
+{
+	return m_NrOfEntities.load(std::memory_order_relaxed);
+}
+
+template<class T>
+const uint64_t ConcurrentPoolAllocator<T>::GetEntityCapacity() const noexcept
+{
+	return m_MaxEntities;
+}
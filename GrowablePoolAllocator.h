@@ -0,0 +1,86 @@
+#pragma once
+#include "pch.h"
+#include "PoolBlockChain.h"
+
+//PoolAllocator without a fixed capacity: it adds a block (64 KiB by default, 2 MiB blocks get
+//huge page backing) when every chunk is in use, and gives back blocks that become empty.
+template<class T>
+class GrowablePoolAllocator
+{
+public:
+	GrowablePoolAllocator(const char* tag, const size_t blockSize = 64u * 1024u, const bool releaseEmptyBlocks = true);
+	~GrowablePoolAllocator() = default;
+	template<typename... Arguments>
+	T* New(Arguments&&... args);
+	void Delete(T* pData);
+	[[nodiscard]] const char* GetTag() const noexcept;
+	[[nodiscard]] const uint64_t GetUsage() const noexcept;
+	[[nodiscard]] const uint64_t GetCapacity() const noexcept;
+	[[nodiscard]] const uint64_t GetEntityUsage() const noexcept;
+	[[nodiscard]] const uint64_t GetEntityCapacity() const noexcept;
+	[[nodiscard]] const uint64_t GetBlockCount() const noexcept;
+
+private:
+	PoolBlockChain m_Blocks;
+	const char* m_Tag;
+};
+
+template<class T>
+GrowablePoolAllocator<T>::GrowablePoolAllocator(const char* tag, const size_t blockSize, const bool releaseEmptyBlocks)
+	: m_Blocks{ sizeof(T), alignof(T), blockSize, releaseEmptyBlocks },
+	  m_Tag{ tag }
+{
+}
+
+template<class T>
+template<typename ...Arguments>
+T* GrowablePoolAllocator<T>::New(Arguments&&... args)
+{
+	void* pChunk = m_Blocks.Allocate();
+	if (pChunk == nullptr)
+		return nullptr;
+	return new(pChunk)T(std::forward<Arguments>(args)...);
+}
+
+template<class T>
+void GrowablePoolAllocator<T>::Delete(T* pData)
+{
+	pData->~T();
+	m_Blocks.Deallocate(pData);
+}
+
+template<typename T>
+const char* GrowablePoolAllocator<T>::GetTag() const noexcept
+{
+	return m_Tag;
+}
+
+template<class T>
+const uint64_t GrowablePoolAllocator<T>::GetUsage() const noexcept
+{
+	return m_Blocks.GetUsedChunks() * m_Blocks.GetChunkSize();
+}
+
+template<class T>
+const uint64_t GrowablePoolAllocator<T>::GetCapacity() const noexcept
+{
+	return GetEntityCapacity() * m_Blocks.GetChunkSize();
+}
+
+template<class T>
+const uint64_t GrowablePoolAllocator<T>::GetEntityUsage() const noexcept
+{
+	return m_Blocks.GetUsedChunks();
+}
+
+template<class T>
+const uint64_t GrowablePoolAllocator<T>::GetEntityCapacity() const noexcept
+{
+	return m_Blocks.GetBlockCount() * m_Blocks.GetChunksPerBlock();
+}
+
+template<class T>
+const uint64_t GrowablePoolAllocator<T>::GetBlockCount() const noexcept
+{
+	return m_Blocks.GetBlockCount();
+}
@@ -1,27 +1,76 @@
 #pragma once
 #include "pch.h"
+#include "VirtualMemory.h"
+#include <span>
+#include <type_traits>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <thread>
+
+//Checked mode poisons freed chunks, guards every object with canaries and asserts on double or
+//foreign deletes. On in debug builds, define POOL_ALLOCATOR_CHECKED to 0 or 1 to override.
+#ifndef POOL_ALLOCATOR_CHECKED
+#if defined (DEBUG) | defined (_DEBUG)
+#define POOL_ALLOCATOR_CHECKED 1
+#else
+#define POOL_ALLOCATOR_CHECKED 0
+#endif
+#endif
+
+#if POOL_ALLOCATOR_CHECKED
+//The link is kept out of the payload so all of a freed object can be poisoned, and a canary on
+//either side of the payload is set by New and verified by Delete.
 template<typename T>
 struct PoolChunk
+{
+	PoolChunk<T>* nextPoolChunk;
+	uint64_t frontCanary;
+	alignas(alignof(T))
+	std::byte data[sizeof(T)];
+	uint64_t backCanary;
+};
+#else
+//A chunk is either a live object or a link in the free list, never both, so the link
+//lives in the payload. A chunk is sizeof(T) bytes, but at least one pointer.
+template<typename T>
+union PoolChunk
 {
 	alignas(alignof(T))
 	std::byte data[sizeof(T)];
 	PoolChunk<T>* nextPoolChunk;
 };
+#endif
 
 template<class T>
 class PoolAllocator
 {
 public:
-	PoolAllocator(const char* tag, const uint64_t entityCapacity = 1000000u);
+	PoolAllocator(const char* tag, const uint64_t entityCapacity = 1000000u, const PageBacking backing = PageBacking::Small);
 	~PoolAllocator();
 	template<typename... Arguments>
 	T* New(Arguments&&... args);
 	void Delete(T* pData);
+	//Creates up to count objects (at most objects.size()) into objects, returns how many it made.
+	//Every object is constructed from the same arguments, so they are copied, not forwarded.
+	template<typename... Arguments>
+	uint64_t NewN(const uint64_t count, std::span<T*> objects, const Arguments&... args);
+	//Deletes every object in objects, the chunks go back to the free list as one run.
+	void DeleteN(std::span<T* const> objects);
+	//Calls func(T&) on every live object in address order. func may Delete the object it was
+	//given; objects it creates may or may not be visited.
+	template<typename Function>
+	void ForEach(Function&& func);
+	//ForEach with the blocks of the pool spread over nrOfThreads threads (0 = one per hardware thread).
+	//func is called concurrently and must not New or Delete.
+	template<typename Function>
+	void ParallelForEach(Function&& func, uint32_t nrOfThreads = 0u);
 	[[nodiscard]] const char* GetTag() const noexcept;
 	[[nodiscard]] const uint64_t GetUsage() const noexcept;
 	[[nodiscard]] const uint64_t GetCapacity() const noexcept;
 	[[nodiscard]] const uint64_t GetEntityUsage() const noexcept;
 	[[nodiscard]] const uint64_t GetEntityCapacity() const noexcept;
+	[[nodiscard]] const PageBacking GetPageBacking() const noexcept;
 	[[nodiscard]] const uint64_t GetNrOfEntitiesAllocatedEveryFrame() const noexcept;
 	[[nodiscard]] const uint64_t GetNrOfEntitiesDeallocatedEveryFrame() const noexcept;
 	void SetNrOfEntitiesAllocatedEveryFrame(const uint64_t nrOfEntities) noexcept;
@@ -38,11 +87,43 @@ public:
 	void FreeAllMemory(const std::vector<T*>& objects) noexcept;
 
 private:
+	[[nodiscard]] bool CommitChunk(const uint64_t chunkIndex) noexcept;
+	[[nodiscard]] static PoolChunk<T>* ChunkOf(T* pData) noexcept;
+	[[nodiscard]] static T* DataOf(PoolChunk<T>* pPoolChunk) noexcept;
+#if POOL_ALLOCATOR_CHECKED
+	//Before a free chunk is handed out: nothing wrote to it since Delete.
+	void CheckFreeChunk(const PoolChunk<T>* pPoolChunk) const noexcept;
+	//Before a chunk is freed: it is a live object of this pool and stayed inside its chunk.
+	void CheckLiveChunk(const PoolChunk<T>* pPoolChunk) const noexcept;
+	static void ArmChunk(PoolChunk<T>* pPoolChunk) noexcept;
+	static void PoisonChunk(PoolChunk<T>* pPoolChunk) noexcept;
+
+	static constexpr uint64_t s_Canary = 0xC0DEC0DEC0DEC0DEu;
+	//Same as the dead land fill of the debug CRT.
+	static constexpr std::byte s_Poison{ 0xDD };
+#endif
+	void MarkLive(const PoolChunk<T>* pPoolChunk) noexcept;
+	void MarkFree(const PoolChunk<T>* pPoolChunk) noexcept;
+	template<typename Function>
+	void ForEachInWords(Function& func, const uint64_t firstWord, const uint64_t endWord);
+
+	//Pages are committed this many bytes at a time as the pool fills.
+	static constexpr uint64_t s_CommitGranule = 64u * 1024u;
+	//ParallelForEach hands out the pool in blocks of this many occupancy words (64 chunks each).
+	static constexpr uint64_t s_WordsPerBlock = 64u;
+
 	PoolChunk<T>* m_pMemoryPool;
+	//Free list of recycled chunks only, chunks that were never used are handed out by m_NextUnusedChunk.
 	PoolChunk<T>* m_pHead;
 	const char* m_Tag;
 	uint64_t m_MaxEntities;
 	uint64_t m_BytesCapacity;
+	uint64_t m_MappedBytes;
+	PageBacking m_PageBacking;
+	uint64_t m_NextUnusedChunk;
+	uint64_t m_CommittedBytes;
+	//One bit per chunk that has ever been handed out, set while it holds a live object.
+	std::vector<uint64_t> m_Occupancy;
 	uint64_t m_UsedBytes;
 	uint64_t m_NrOfEntities;
 	uint64_t m_NrOfEntitiesAllocatedEveryFrame;
@@ -54,10 +135,16 @@ private:
 };
 
 template<class T>
-PoolAllocator<T>::PoolAllocator(const char* tag, const uint64_t entityCapacity)
-	: m_Tag{tag}, 
+PoolAllocator<T>::PoolAllocator(const char* tag, const uint64_t entityCapacity, const PageBacking backing)
+	: m_pHead{nullptr},
+	  m_Tag{tag}, 
 	  m_MaxEntities{ entityCapacity }, 
-	  m_BytesCapacity{ sizeof(T) * m_MaxEntities },
+	  m_BytesCapacity{ sizeof(PoolChunk<T>) * m_MaxEntities },
+	  m_MappedBytes{0u},
+	  m_PageBacking{PageBacking::Small},
+	  m_NextUnusedChunk{0u},
+	  m_CommittedBytes{0u},
+	  m_Occupancy{},
 	  m_UsedBytes{0u},
 	  m_NrOfEntities{0u},
 	  m_NrOfEntitiesAllocatedEveryFrame{0u},
@@ -67,20 +154,33 @@ PoolAllocator<T>::PoolAllocator(const char* tag, const uint64_t entityCapacity)
 	  m_DeallocateOnFrame{true},
 	  m_AllocAndDeallocSameAmount{false}
 {
-	m_pMemoryPool = DBG_NEW PoolChunk<T>[m_MaxEntities];
-	m_pHead = m_pMemoryPool;
-
-	for (uint64_t i{ 0u }; i < m_MaxEntities - 1; i++)
+	//Huge pages are only used for a whole number of them, so round the mapping up to one.
+	const size_t hugePageSize = VirtualMemory::GetHugePageSize();
+	const size_t pageSize = backing == PageBacking::Huge && hugePageSize ? hugePageSize : VirtualMemory::GetPageSize();
+	m_MappedBytes = (sizeof(PoolChunk<T>) * m_MaxEntities + pageSize - 1) / pageSize * pageSize;
+	if (backing == PageBacking::Huge)
+	{
+		//Huge pages are mapped up front.
+		m_pMemoryPool = static_cast<PoolChunk<T>*>(VirtualMemory::AllocateAligned(m_MappedBytes, alignof(PoolChunk<T>), backing, &m_PageBacking));
+		m_CommittedBytes = m_MappedBytes;
+	}
+	else
 	{
-		m_pMemoryPool[i].nextPoolChunk = std::addressof(m_pMemoryPool[i + 1]);
+		//Only reserve, nothing is touched until New hands out chunks.
+		m_pMemoryPool = static_cast<PoolChunk<T>*>(VirtualMemory::Reserve(m_MappedBytes));
 	}
-	m_pMemoryPool[m_MaxEntities - 1].nextPoolChunk = nullptr;
+	if (!m_pMemoryPool)
+	{
+		throw std::bad_alloc();
+	}
+	//Words are added as m_NextUnusedChunk moves, reserving up front keeps New from reallocating.
+	m_Occupancy.reserve((m_MaxEntities + 63u) / 64u);
 }
 
 template<class T>
 PoolAllocator<T>::~PoolAllocator()
 {
-	delete[] m_pMemoryPool;
+	VirtualMemory::Release(m_pMemoryPool, m_MappedBytes);
 	m_pMemoryPool = nullptr;
 	m_pHead = nullptr;
 }
@@ -89,13 +189,29 @@ template<class T>
 template<typename ...Arguments>
 T* PoolAllocator<T>::New(Arguments&&... args)
 {
-	if (m_pHead == nullptr)
-		return nullptr;
-
 	PoolChunk<T>* pPoolChunk = m_pHead;
-	m_pHead = m_pHead->nextPoolChunk;
+	if (pPoolChunk)
+	{
+#if POOL_ALLOCATOR_CHECKED
+		CheckFreeChunk(pPoolChunk);
+#endif
+		m_pHead = m_pHead->nextPoolChunk;
+	}
+	else
+	{
+		//Free list is empty, take the next chunk that was never used.
+		if (m_NextUnusedChunk == m_MaxEntities || !CommitChunk(m_NextUnusedChunk))
+			return nullptr;
+		if ((m_NextUnusedChunk & 63u) == 0u)
+			m_Occupancy.push_back(0u);
+		pPoolChunk = std::addressof(m_pMemoryPool[m_NextUnusedChunk++]);
+	}
 
-	m_UsedBytes += sizeof(T);
+	MarkLive(pPoolChunk);
+#if POOL_ALLOCATOR_CHECKED
+	ArmChunk(pPoolChunk);
+#endif
+	m_UsedBytes += sizeof(PoolChunk<T>);
 	m_NrOfEntities++;
 
 	return new(std::addressof(pPoolChunk->data))T(std::forward<Arguments>(args)...);
@@ -104,14 +220,256 @@ T* PoolAllocator<T>::New(Arguments&&... args)
 template<class T>
 void PoolAllocator<T>::Delete(T* pData)
 {
-	m_UsedBytes -= sizeof(T);
+	PoolChunk<T>* poolChunk = ChunkOf(pData);
+#if POOL_ALLOCATOR_CHECKED
+	CheckLiveChunk(poolChunk);
+#endif
+	m_UsedBytes -= sizeof(PoolChunk<T>);
 	pData->~T();
-	PoolChunk<T>* poolChunk = reinterpret_cast<PoolChunk<T>*>(pData);
+	MarkFree(poolChunk);
+#if POOL_ALLOCATOR_CHECKED
+	PoisonChunk(poolChunk);
+#endif
 	poolChunk->nextPoolChunk = m_pHead;
 	m_pHead = poolChunk;
 	m_NrOfEntities--;
 }
 
+template<class T>
+bool PoolAllocator<T>::CommitChunk(const uint64_t chunkIndex) noexcept
+{
+	const uint64_t endOfChunk = (chunkIndex + 1) * sizeof(PoolChunk<T>);
+	if (endOfChunk <= m_CommittedBytes)
+		return true;
+
+	uint64_t newCommittedBytes = (endOfChunk + s_CommitGranule - 1) / s_CommitGranule * s_CommitGranule;
+	if (newCommittedBytes > m_MappedBytes)
+		newCommittedBytes = m_MappedBytes;
+	if (!VirtualMemory::Commit(reinterpret_cast<std::byte*>(m_pMemoryPool) + m_CommittedBytes, newCommittedBytes - m_CommittedBytes))
+		return false;
+	m_CommittedBytes = newCommittedBytes;
+	return true;
+}
+
+template<class T>
+PoolChunk<T>* PoolAllocator<T>::ChunkOf(T* pData) noexcept
+{
+	return reinterpret_cast<PoolChunk<T>*>(reinterpret_cast<std::byte*>(pData) - offsetof(PoolChunk<T>, data));
+}
+
+template<class T>
+T* PoolAllocator<T>::DataOf(PoolChunk<T>* pPoolChunk) noexcept
+{
+	return reinterpret_cast<T*>(std::addressof(pPoolChunk->data));
+}
+
+#if POOL_ALLOCATOR_CHECKED
+template<class T>
+void PoolAllocator<T>::CheckFreeChunk(const PoolChunk<T>* pPoolChunk) const noexcept
+{
+	for (size_t i{ 0u }; i < sizeof(T); i++)
+	{
+		assert(pPoolChunk->data[i] == s_Poison && "Deleted object was written to");
+	}
+}
+
+template<class T>
+void PoolAllocator<T>::CheckLiveChunk(const PoolChunk<T>* pPoolChunk) const noexcept
+{
+	const uintptr_t offset = reinterpret_cast<uintptr_t>(pPoolChunk) - reinterpret_cast<uintptr_t>(m_pMemoryPool);
+	assert(offset < m_NextUnusedChunk * sizeof(PoolChunk<T>) && offset % sizeof(PoolChunk<T>) == 0 && "Object doesn't belong to this pool");
+	const uint64_t chunkIndex = offset / sizeof(PoolChunk<T>);
+	assert(((m_Occupancy[chunkIndex / 64u] >> (chunkIndex % 64u)) & 1u) && "Object was already deleted");
+	assert(pPoolChunk->frontCanary == s_Canary && "Memory in front of the object was overwritten");
+	assert(pPoolChunk->backCanary == s_Canary && "Object overran its chunk");
+}
+
+template<class T>
+void PoolAllocator<T>::ArmChunk(PoolChunk<T>* pPoolChunk) noexcept
+{
+	pPoolChunk->frontCanary = s_Canary;
+	pPoolChunk->backCanary = s_Canary;
+}
+
+template<class T>
+void PoolAllocator<T>::PoisonChunk(PoolChunk<T>* pPoolChunk) noexcept
+{
+	std::memset(std::addressof(pPoolChunk->data), static_cast<int>(s_Poison), sizeof(T));
+}
+#endif
+
+template<class T>
+void PoolAllocator<T>::MarkLive(const PoolChunk<T>* pPoolChunk) noexcept
+{
+	const uint64_t chunkIndex = static_cast<uint64_t>(pPoolChunk - m_pMemoryPool);
+	m_Occupancy[chunkIndex / 64u] |= uint64_t{ 1u } << (chunkIndex % 64u);
+}
+
+template<class T>
+void PoolAllocator<T>::MarkFree(const PoolChunk<T>* pPoolChunk) noexcept
+{
+	const uint64_t chunkIndex = static_cast<uint64_t>(pPoolChunk - m_pMemoryPool);
+	m_Occupancy[chunkIndex / 64u] &= ~(uint64_t{ 1u } << (chunkIndex % 64u));
+}
+
+template<class T>
+template<typename ...Arguments>
+uint64_t PoolAllocator<T>::NewN(const uint64_t count, std::span<T*> objects, const Arguments&... args)
+{
+	const uint64_t wanted = count < objects.size() ? count : objects.size();
+	uint64_t created = 0u;
+
+	//Recycled chunks first, the list is cut once after the run instead of per object.
+	PoolChunk<T>* pPoolChunk = m_pHead;
+	while (created < wanted && pPoolChunk)
+	{
+#if POOL_ALLOCATOR_CHECKED
+		CheckFreeChunk(pPoolChunk);
+#endif
+		objects[created++] = DataOf(pPoolChunk);
+		pPoolChunk = pPoolChunk->nextPoolChunk;
+	}
+	m_pHead = pPoolChunk;
+
+	//Then a run of never-used chunks, committed in one go.
+	uint64_t nrOfUnused = wanted - created;
+	if (nrOfUnused > m_MaxEntities - m_NextUnusedChunk)
+		nrOfUnused = m_MaxEntities - m_NextUnusedChunk;
+	if (nrOfUnused > 0u && CommitChunk(m_NextUnusedChunk + nrOfUnused - 1u))
+	{
+		for (uint64_t i{ 0u }; i < nrOfUnused; i++)
+		{
+			objects[created++] = DataOf(std::addressof(m_pMemoryPool[m_NextUnusedChunk + i]));
+		}
+		m_NextUnusedChunk += nrOfUnused;
+		m_Occupancy.resize((m_NextUnusedChunk + 63u) / 64u, 0u);
+	}
+
+	m_UsedBytes += created * sizeof(PoolChunk<T>);
+	m_NrOfEntities += created;
+
+	//Only construct once the free list links have been read, constructing overwrites them.
+	for (uint64_t i{ 0u }; i < created; i++)
+	{
+		MarkLive(ChunkOf(objects[i]));
+#if POOL_ALLOCATOR_CHECKED
+		ArmChunk(ChunkOf(objects[i]));
+#endif
+		new(objects[i])T(args...);
+	}
+	return created;
+}
+
+template<class T>
+void PoolAllocator<T>::DeleteN(std::span<T* const> objects)
+{
+	if (objects.empty())
+		return;
+
+#if POOL_ALLOCATOR_CHECKED
+	//Checked and marked free one at a time, so an object listed twice is caught as well.
+	for (T* pData : objects)
+	{
+		CheckLiveChunk(ChunkOf(pData));
+		MarkFree(ChunkOf(pData));
+	}
+#endif
+
+	if constexpr (!std::is_trivially_destructible_v<T>)
+	{
+		for (T* pData : objects)
+		{
+			pData->~T();
+		}
+	}
+
+#if POOL_ALLOCATOR_CHECKED
+	for (T* pData : objects)
+	{
+		PoisonChunk(ChunkOf(pData));
+	}
+#else
+	for (T* pData : objects)
+	{
+		MarkFree(ChunkOf(pData));
+	}
+#endif
+
+	//Link the chunks to each other and put the whole run in front of the free list.
+	for (size_t i{ 0u }; i + 1 < objects.size(); i++)
+	{
+		ChunkOf(objects[i])->nextPoolChunk = ChunkOf(objects[i + 1]);
+	}
+	ChunkOf(objects.back())->nextPoolChunk = m_pHead;
+	m_pHead = ChunkOf(objects.front());
+
+	m_UsedBytes -= objects.size() * sizeof(PoolChunk<T>);
+	m_NrOfEntities -= objects.size();
+}
+
+template<class T>
+template<typename Function>
+void PoolAllocator<T>::ForEach(Function&& func)
+{
+	ForEachInWords(func, 0u, m_Occupancy.size());
+}
+
+template<class T>
+template<typename Function>
+void PoolAllocator<T>::ParallelForEach(Function&& func, uint32_t nrOfThreads)
+{
+	const uint64_t nrOfWords = m_Occupancy.size();
+	const uint64_t nrOfBlocks = (nrOfWords + s_WordsPerBlock - 1u) / s_WordsPerBlock;
+	if (nrOfThreads == 0u)
+		nrOfThreads = std::max(1u, std::thread::hardware_concurrency());
+	if (nrOfThreads > nrOfBlocks)
+		nrOfThreads = static_cast<uint32_t>(nrOfBlocks);
+	if (nrOfThreads <= 1u)
+	{
+		ForEachInWords(func, 0u, nrOfWords);
+		return;
+	}
+
+	//Blocks are taken one at a time, so threads that hit sparse blocks pick up more of them.
+	std::atomic<uint64_t> nextBlock{ 0u };
+	auto work = [&]()
+	{
+		for (uint64_t block = nextBlock.fetch_add(1u, std::memory_order_relaxed); block < nrOfBlocks; block = nextBlock.fetch_add(1u, std::memory_order_relaxed))
+		{
+			const uint64_t firstWord = block * s_WordsPerBlock;
+			ForEachInWords(func, firstWord, std::min(firstWord + s_WordsPerBlock, nrOfWords));
+		}
+	};
+	std::vector<std::thread> threads;
+	threads.reserve(nrOfThreads - 1u);
+	for (uint32_t t{ 1u }; t < nrOfThreads; t++)
+	{
+		threads.emplace_back(work);
+	}
+	work();
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+template<class T>
+template<typename Function>
+void PoolAllocator<T>::ForEachInWords(Function& func, const uint64_t firstWord, const uint64_t endWord)
+{
+	for (uint64_t word{ firstWord }; word < endWord; word++)
+	{
+		//A copy, so func deleting its object doesn't change what is left to visit in this word.
+		uint64_t bits = m_Occupancy[word];
+		while (bits != 0u)
+		{
+			const uint64_t chunkIndex = word * 64u + std::countr_zero(bits);
+			bits &= bits - 1u;
+			func(*std::launder(DataOf(std::addressof(m_pMemoryPool[chunkIndex]))));
+		}
+	}
+}
+
 template<typename T>
 const char* PoolAllocator<T>::GetTag() const noexcept
 {
@@ -142,6 +500,12 @@ const uint64_t PoolAllocator<T>::GetEntityCapacity() const noexcept
 	return m_MaxEntities;
 }
 
+template<class T>
+const PageBacking PoolAllocator<T>::GetPageBacking() const noexcept
+{
+	return m_PageBacking;
+}
+
 template<typename T>
 const uint64_t PoolAllocator<T>::GetNrOfEntitiesAllocatedEveryFrame() const noexcept
 {
@@ -0,0 +1,169 @@
+#include "pch.h"
+#include "PoolBlockChain.h"
+#include "VirtualMemory.h"
+#include <algorithm>
+
+PoolBlockChain::PoolBlockChain(const size_t chunkSize, const size_t chunkAlignment, const size_t blockSize, const bool releaseEmptyBlocks) noexcept
+	: m_BlockSize{ blockSize },
+	  m_ReleaseEmptyBlocks{ releaseEmptyBlocks },
+	  m_PageBacking{ PageBacking::Small },
+	  m_pBlocks{ nullptr },
+	  m_pAvailable{ nullptr },
+	  m_NrOfBlocks{ 0u },
+	  m_NrOfUsedChunks{ 0u }
+{
+	assert((blockSize & (blockSize - 1)) == 0 && "Block size has to be a power of two");
+	//Free chunks hold the free-list link, so they are at least a pointer in size and alignment.
+	const size_t alignment = chunkAlignment > alignof(void*) ? chunkAlignment : alignof(void*);
+	m_ChunkSize = (std::max(chunkSize, sizeof(void*)) + alignment - 1) / alignment * alignment;
+	m_ChunksOffset = (sizeof(PoolBlock) + alignment - 1) / alignment * alignment;
+	m_ChunksPerBlock = (blockSize - m_ChunksOffset) / m_ChunkSize;
+	assert(m_ChunksPerBlock > 0 && "Block too small for a single chunk");
+	const size_t hugePageSize = VirtualMemory::GetHugePageSize();
+	if (hugePageSize && blockSize % hugePageSize == 0)
+		m_PageBacking = PageBacking::Huge;
+}
+
+PoolBlockChain::~PoolBlockChain()
+{
+	while (m_pBlocks)
+	{
+		PoolBlock* pNext = m_pBlocks->pNext;
+		VirtualMemory::Release(m_pBlocks, m_BlockSize);
+		m_pBlocks = pNext;
+	}
+	m_pAvailable = nullptr;
+}
+
+void* PoolBlockChain::Allocate() noexcept
+{
+	PoolBlock* pBlock = m_pAvailable;
+	if (!pBlock)
+	{
+		pBlock = AddBlock();
+		if (!pBlock)
+			return nullptr;
+	}
+
+	void* pChunk = pBlock->pFreeList;
+	if (pChunk)
+	{
+		pBlock->pFreeList = *static_cast<void**>(pChunk);
+	}
+	else
+	{
+		pChunk = ChunksOf(pBlock) + pBlock->nextUnusedChunk * m_ChunkSize;
+		pBlock->nextUnusedChunk++;
+	}
+
+	pBlock->nrOfUsedChunks++;
+	m_NrOfUsedChunks++;
+	if (pBlock->nrOfUsedChunks == m_ChunksPerBlock)
+	{
+		RemoveAvailable(pBlock);
+	}
+	return pChunk;
+}
+
+void PoolBlockChain::Deallocate(void* pChunk) noexcept
+{
+	PoolBlock* pBlock = reinterpret_cast<PoolBlock*>(reinterpret_cast<uintptr_t>(pChunk) & ~(static_cast<uintptr_t>(m_BlockSize) - 1));
+	*static_cast<void**>(pChunk) = pBlock->pFreeList;
+	pBlock->pFreeList = pChunk;
+
+	if (pBlock->nrOfUsedChunks == m_ChunksPerBlock)
+	{
+		PushAvailable(pBlock);
+	}
+	pBlock->nrOfUsedChunks--;
+	m_NrOfUsedChunks--;
+
+	//Keep the last available block so a pool hovering around a block boundary doesn't map and unmap every frame.
+	if (pBlock->nrOfUsedChunks == 0 && m_ReleaseEmptyBlocks && (pBlock->pPrevAvailable || pBlock->pNextAvailable))
+	{
+		ReleaseBlock(pBlock);
+	}
+}
+
+size_t PoolBlockChain::GetChunkSize() const noexcept
+{
+	return m_ChunkSize;
+}
+
+size_t PoolBlockChain::GetBlockSize() const noexcept
+{
+	return m_BlockSize;
+}
+
+size_t PoolBlockChain::GetChunksPerBlock() const noexcept
+{
+	return m_ChunksPerBlock;
+}
+
+size_t PoolBlockChain::GetBlockCount() const noexcept
+{
+	return m_NrOfBlocks;
+}
+
+size_t PoolBlockChain::GetUsedChunks() const noexcept
+{
+	return m_NrOfUsedChunks;
+}
+
+PoolBlockChain::PoolBlock* PoolBlockChain::AddBlock() noexcept
+{
+	PoolBlock* pBlock = static_cast<PoolBlock*>(VirtualMemory::AllocateAligned(m_BlockSize, m_BlockSize, m_PageBacking));
+	if (!pBlock)
+		return nullptr;
+
+	pBlock->pFreeList = nullptr;
+	pBlock->nextUnusedChunk = 0u;
+	pBlock->nrOfUsedChunks = 0u;
+	pBlock->pPrev = nullptr;
+	pBlock->pNext = m_pBlocks;
+	if (m_pBlocks)
+		m_pBlocks->pPrev = pBlock;
+	m_pBlocks = pBlock;
+	PushAvailable(pBlock);
+	m_NrOfBlocks++;
+	return pBlock;
+}
+
+void PoolBlockChain::ReleaseBlock(PoolBlock* pBlock) noexcept
+{
+	RemoveAvailable(pBlock);
+	if (pBlock->pPrev)
+		pBlock->pPrev->pNext = pBlock->pNext;
+	else
+		m_pBlocks = pBlock->pNext;
+	if (pBlock->pNext)
+		pBlock->pNext->pPrev = pBlock->pPrev;
+	VirtualMemory::Release(pBlock, m_BlockSize);
+	m_NrOfBlocks--;
+}
+
+void PoolBlockChain::PushAvailable(PoolBlock* pBlock) noexcept
+{
+	pBlock->pPrevAvailable = nullptr;
+	pBlock->pNextAvailable = m_pAvailable;
+	if (m_pAvailable)
+		m_pAvailable->pPrevAvailable = pBlock;
+	m_pAvailable = pBlock;
+}
+
+void PoolBlockChain::RemoveAvailable(PoolBlock* pBlock) noexcept
+{
+	if (pBlock->pPrevAvailable)
+		pBlock->pPrevAvailable->pNextAvailable = pBlock->pNextAvailable;
+	else
+		m_pAvailable = pBlock->pNextAvailable;
+	if (pBlock->pNextAvailable)
+		pBlock->pNextAvailable->pPrevAvailable = pBlock->pPrevAvailable;
+	pBlock->pPrevAvailable = nullptr;
+	pBlock->pNextAvailable = nullptr;
+}
+
+std::byte* PoolBlockChain::ChunksOf(PoolBlock* pBlock) const noexcept
+{
+	return reinterpret_cast<std::byte*>(pBlock) + m_ChunksOffset;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "VirtualMemory.h"
+
+//Untyped pool that grows a block at a time. Every block is blockSize bytes, aligned to
+//blockSize, and starts with a header, so the block of any chunk is found by masking its
+//address. Each block hands out its never-used chunks with a bump index and keeps its own free
+//list of recycled ones, so a block's objects stay contiguous. Blocks that still have free chunks
+//are kept in a list; blocks that become completely free can be given back to the OS.
+class PoolBlockChain
+{
+public:
+	//blockSize has to be a power of two, at least the page size. Blocks that are a whole number
+	//of huge pages are asked for with huge page backing.
+	PoolBlockChain(const size_t chunkSize, const size_t chunkAlignment, const size_t blockSize = 64u * 1024u, const bool releaseEmptyBlocks = true) noexcept;
+	~PoolBlockChain();
+	PoolBlockChain(const PoolBlockChain&) = delete;
+	PoolBlockChain& operator=(const PoolBlockChain&) = delete;
+
+	//Returns nullptr only when the OS refuses a new block.
+	[[nodiscard]] void* Allocate() noexcept;
+	void Deallocate(void* pChunk) noexcept;
+
+	[[nodiscard]] size_t GetChunkSize() const noexcept;
+	[[nodiscard]] size_t GetBlockSize() const noexcept;
+	[[nodiscard]] size_t GetChunksPerBlock() const noexcept;
+	[[nodiscard]] size_t GetBlockCount() const noexcept;
+	[[nodiscard]] size_t GetUsedChunks() const noexcept;
+private:
+	struct PoolBlock
+	{
+		//Every block.
+		PoolBlock* pPrev;
+		PoolBlock* pNext;
+		//Blocks with at least one free chunk.
+		PoolBlock* pPrevAvailable;
+		PoolBlock* pNextAvailable;
+		//Recycled chunks, the link is stored in the chunk itself.
+		void* pFreeList;
+		uint32_t nextUnusedChunk;
+		uint32_t nrOfUsedChunks;
+	};
+
+	[[nodiscard]] PoolBlock* AddBlock() noexcept;
+	void ReleaseBlock(PoolBlock* pBlock) noexcept;
+	void PushAvailable(PoolBlock* pBlock) noexcept;
+	void RemoveAvailable(PoolBlock* pBlock) noexcept;
+	[[nodiscard]] std::byte* ChunksOf(PoolBlock* pBlock) const noexcept;
+
+	size_t m_ChunkSize;
+	size_t m_BlockSize;
+	size_t m_ChunksOffset;
+	size_t m_ChunksPerBlock;
+	bool m_ReleaseEmptyBlocks;
+	PageBacking m_PageBacking;
+	PoolBlock* m_pBlocks;
+	PoolBlock* m_pAvailable;
+	size_t m_NrOfBlocks;
+	size_t m_NrOfUsedChunks;
+};
@@ -0,0 +1,177 @@
+#pragma once
+#include "pch.h"
+#include "PoolAllocator.h"
+#include <span>
+
+//32-bit handle into a PoolSlotMap: the low bits are the slot, the high bits the generation of
+//the slot when the handle was made. A handle of 0 never refers to anything.
+struct PoolHandle
+{
+	static constexpr uint32_t INDEX_BITS = 20u;
+	static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1u;
+	static constexpr uint32_t GENERATION_MASK = (1u << (32u - INDEX_BITS)) - 1u;
+
+	uint32_t value = 0u;
+
+	[[nodiscard]] uint32_t GetIndex() const noexcept { return value & INDEX_MASK; }
+	[[nodiscard]] uint32_t GetGeneration() const noexcept { return value >> INDEX_BITS; }
+	explicit operator bool() const noexcept { return value != 0u; }
+	bool operator==(const PoolHandle&) const = default;
+};
+
+//PoolAllocator that hands out PoolHandles instead of pointers. Get is O(1) and returns nullptr
+//for a handle whose object was deleted, even if the slot has been reused since (the generation
+//differs; it wraps after 4095 reuses of one slot). Live handles are also kept in a dense array,
+//so iterating over them doesn't need a separately maintained vector.
+template<class T>
+class PoolSlotMap
+{
+public:
+	PoolSlotMap(const char* tag, const uint32_t entityCapacity = PoolHandle::INDEX_MASK);
+	~PoolSlotMap();
+	PoolSlotMap(const PoolSlotMap&) = delete;
+	PoolSlotMap& operator=(const PoolSlotMap&) = delete;
+	//Returns an empty handle when the pool is full.
+	template<typename... Arguments>
+	[[nodiscard]] PoolHandle New(Arguments&&... args);
+	//Returns false, and does nothing, for a stale handle.
+	bool Delete(const PoolHandle handle);
+	[[nodiscard]] T* Get(const PoolHandle handle) const noexcept;
+	[[nodiscard]] bool IsValid(const PoolHandle handle) const noexcept;
+	//Every live handle, in no particular order. Delete invalidates the span.
+	[[nodiscard]] std::span<const PoolHandle> GetHandles() const noexcept;
+	void Clear();
+	[[nodiscard]] const char* GetTag() const noexcept;
+	[[nodiscard]] const uint64_t GetEntityUsage() const noexcept;
+	[[nodiscard]] const uint64_t GetEntityCapacity() const noexcept;
+
+private:
+	struct Slot
+	{
+		T* pObject;
+		uint32_t generation;
+		//Position in m_DenseHandles while live, next free slot + 1 while free.
+		uint32_t denseIndexOrNextFree;
+	};
+
+	PoolAllocator<T> m_Pool;
+	std::vector<Slot> m_Slots;
+	std::vector<PoolHandle> m_DenseHandles;
+	//Index + 1 of the first free slot, 0 when every slot in m_Slots is live.
+	uint32_t m_FirstFreeSlot;
+};
+
+template<class T>
+PoolSlotMap<T>::PoolSlotMap(const char* tag, const uint32_t entityCapacity)
+	: m_Pool{ tag, entityCapacity },
+	  m_FirstFreeSlot{ 0u }
+{
+	assert(entityCapacity <= PoolHandle::INDEX_MASK && "Slot indices have to fit in the handle");
+}
+
+template<class T>
+PoolSlotMap<T>::~PoolSlotMap()
+{
+	Clear();
+}
+
+template<class T>
+template<typename ...Arguments>
+PoolHandle PoolSlotMap<T>::New(Arguments&&... args)
+{
+	T* pObject = m_Pool.New(std::forward<Arguments>(args)...);
+	if (pObject == nullptr)
+		return {};
+
+	//Reuse a free slot, or add one. The pool bounds the number of live objects, so this stays within capacity.
+	uint32_t index;
+	if (m_FirstFreeSlot != 0u)
+	{
+		index = m_FirstFreeSlot - 1u;
+		m_FirstFreeSlot = m_Slots[index].denseIndexOrNextFree;
+	}
+	else
+	{
+		index = static_cast<uint32_t>(m_Slots.size());
+		m_Slots.push_back({ nullptr, 1u, 0u });
+	}
+
+	Slot& slot = m_Slots[index];
+	slot.pObject = pObject;
+	slot.denseIndexOrNextFree = static_cast<uint32_t>(m_DenseHandles.size());
+	const PoolHandle handle{ (slot.generation << PoolHandle::INDEX_BITS) | index };
+	m_DenseHandles.push_back(handle);
+	return handle;
+}
+
+template<class T>
+bool PoolSlotMap<T>::Delete(const PoolHandle handle)
+{
+	if (!IsValid(handle))
+		return false;
+
+	const uint32_t index = handle.GetIndex();
+	Slot& slot = m_Slots[index];
+	m_Pool.Delete(slot.pObject);
+	slot.pObject = nullptr;
+
+	//Keep the dense array packed by moving the last handle into the hole.
+	const PoolHandle last = m_DenseHandles.back();
+	m_DenseHandles[slot.denseIndexOrNextFree] = last;
+	m_Slots[last.GetIndex()].denseIndexOrNextFree = slot.denseIndexOrNextFree;
+	m_DenseHandles.pop_back();
+
+	//Generation 0 is skipped, so no live handle is ever 0.
+	slot.generation = (slot.generation + 1u) & PoolHandle::GENERATION_MASK;
+	if (slot.generation == 0u)
+		slot.generation = 1u;
+	slot.denseIndexOrNextFree = m_FirstFreeSlot;
+	m_FirstFreeSlot = index + 1u;
+	return true;
+}
+
+template<class T>
+T* PoolSlotMap<T>::Get(const PoolHandle handle) const noexcept
+{
+	return IsValid(handle) ? m_Slots[handle.GetIndex()].pObject : nullptr;
+}
+
+template<class T>
+bool PoolSlotMap<T>::IsValid(const PoolHandle handle) const noexcept
+{
+	const uint32_t index = handle.GetIndex();
+	return index < m_Slots.size() && m_Slots[index].pObject != nullptr && m_Slots[index].generation == handle.GetGeneration();
+}
+
+template<class T>
+std::span<const PoolHandle> PoolSlotMap<T>::GetHandles() const noexcept
+{
+	return m_DenseHandles;
+}
+
+template<class T>
+void PoolSlotMap<T>::Clear()
+{
+	while (!m_DenseHandles.empty())
+	{
+		Delete(m_DenseHandles.back());
+	}
+}
+
+template<typename T>
+const char* PoolSlotMap<T>::GetTag() const noexcept
+{
+	return m_Pool.GetTag();
+}
+
+template<class T>
+const uint64_t PoolSlotMap<T>::GetEntityUsage() const noexcept
+{
+	return m_DenseHandles.size();
+}
+
+template<class T>
+const uint64_t PoolSlotMap<T>::GetEntityCapacity() const noexcept
+{
+	return m_Pool.GetEntityCapacity();
+}
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <bit>
+#include <cassert>
+#include <new>
+#include <utility>
+
+/// Small objects on top of a buddy heap (BuddyAllocator or BuddyHeap).
+/// A slab is one SLAB_SIZE buddy block carved into objects of a single size class,
+/// with a bitmap of free objects. Buddy blocks are aligned to their own size, so the
+/// slab header of any object is found by masking its address. Slabs that become empty
+/// go back to the heap, except the last partial one of a class so that alloc/free
+/// around an empty slab doesn't split and merge every time.
+/// Sizes above the largest class are passed straight to the heap.
+template<typename Heap>
+class SlabAllocator
+{
+public:
+	constexpr static size_t SLAB_SIZE = size_t{1} << 14;
+	constexpr static size_t CLASS_GRANULE = 16;
+	/// 112 fits Cube (100 bytes + vptr)
+	constexpr static size_t CLASS_SIZES[] = {16, 32, 48, 64, 96, 112, 128, 160, 192, 256};
+	constexpr static int CLASSES = sizeof(CLASS_SIZES) / sizeof(CLASS_SIZES[0]);
+	constexpr static size_t MAX_SIZE = CLASS_SIZES[CLASSES - 1];
+	static_assert(SLAB_SIZE >= Heap::MIN_BLOCK && SLAB_SIZE <= Heap::MAX_BLOCK, "A slab has to be a single buddy block");
+private:
+	constexpr static size_t MAX_OBJECTS = SLAB_SIZE / CLASS_SIZES[0];
+	constexpr static size_t FREE_WORDS = MAX_OBJECTS / 64;
+
+	struct Slab
+	{
+		Slab* prev;
+		Slab* next;
+		uint32_t sizeClass;
+		uint32_t objectSize;
+		uint32_t capacity;
+		uint32_t freeCount;
+		// 1 = free
+		uint64_t freeBits[FREE_WORDS];
+	};
+	constexpr static size_t OBJECTS_OFFSET = (sizeof(Slab) + CLASS_GRANULE - 1) & ~(CLASS_GRANULE - 1);
+
+	/// Size rounded up to CLASS_GRANULE -> smallest class that fits
+	constexpr static auto CLASS_OF = [] {
+		struct Table { uint8_t entries[MAX_SIZE / CLASS_GRANULE + 1]; } table{};
+		int sizeClass = 0;
+		for (size_t i = 0; i <= MAX_SIZE / CLASS_GRANULE; ++i)
+		{
+			while (CLASS_SIZES[sizeClass] < i * CLASS_GRANULE)
+				++sizeClass;
+			table.entries[i] = static_cast<uint8_t>(sizeClass);
+		}
+		return table;
+	}();
+public:
+	explicit SlabAllocator(Heap& heap) : heap(heap) {}
+	~SlabAllocator() { releaseAll(); }
+	SlabAllocator(const SlabAllocator&) = delete;
+	SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+	[[nodiscard]]
+	void* alloc(size_t size)
+	{
+		if (size == 0)
+			return nullptr;
+		if (size > MAX_SIZE)
+			return heap.alloc(size);
+
+		const int sizeClass = classOf(size);
+		Slab* slab = partial[sizeClass];
+		if (!slab)
+		{
+			slab = newSlab(sizeClass);
+			if (!slab)
+				return nullptr;
+		}
+
+		for (size_t word = 0;; ++word)
+		{
+			if (slab->freeBits[word] == 0)
+				continue;
+			const int bit = std::countr_zero(slab->freeBits[word]);
+			slab->freeBits[word] &= slab->freeBits[word] - 1;
+			if (--slab->freeCount == 0)
+				unlink(slab);
+			return objectsOf(slab) + (word * 64 + bit) * slab->objectSize;
+		}
+	}
+
+	void free(void* ptr, size_t size)
+	{
+		if (!ptr) return;
+		if (size > MAX_SIZE)
+		{
+			heap.free(ptr, size);
+			return;
+		}
+
+		Slab* slab = slabOf(ptr);
+		const size_t index = (static_cast<std::byte*>(ptr) - objectsOf(slab)) / slab->objectSize;
+		assert(slab->objectSize == CLASS_SIZES[classOf(size)] && "Size doesn't match the allocation");
+		assert(!(slab->freeBits[index / 64] & (uint64_t{1} << (index % 64))) && "Double free");
+		slab->freeBits[index / 64] |= uint64_t{1} << (index % 64);
+
+		if (slab->freeCount++ == 0)
+			pushPartial(slab);
+		if (slab->freeCount == slab->capacity && (slab->prev || slab->next))
+		{
+			unlink(slab);
+			--slabCount;
+			heap.free(slab, SLAB_SIZE);
+		}
+	}
+
+	template<typename T, typename... Args>
+	[[nodiscard]]
+	T* New(Args&&... args)
+	{
+		static_assert(alignof(T) <= CLASS_GRANULE, "Slab objects are only 16 byte aligned");
+		void* ptr = alloc(sizeof(T));
+		return ptr ? new (ptr) T(std::forward<Args>(args)...) : nullptr;
+	}
+
+	template<typename T>
+	void Delete(T* object)
+	{
+		if (!object) return;
+		object->~T();
+		free(object, sizeof(T));
+	}
+
+	/// Objects a slab of the class holding size fits
+	static size_t objectsPerSlab(size_t size)
+	{
+		return (SLAB_SIZE - OBJECTS_OFFSET) / CLASS_SIZES[classOf(size)];
+	}
+
+	size_t getSlabCount() const { return slabCount; }
+private:
+	static int classOf(size_t size)
+	{
+		return CLASS_OF.entries[(size + CLASS_GRANULE - 1) / CLASS_GRANULE];
+	}
+
+	static Slab* slabOf(const void* ptr)
+	{
+		return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(ptr) & ~(uintptr_t{SLAB_SIZE} - 1));
+	}
+
+	static std::byte* objectsOf(Slab* slab)
+	{
+		return reinterpret_cast<std::byte*>(slab) + OBJECTS_OFFSET;
+	}
+
+	Slab* newSlab(int sizeClass)
+	{
+		void* block = heap.alloc(SLAB_SIZE);
+		if (!block)
+			return nullptr;
+
+		Slab* slab = static_cast<Slab*>(block);
+		slab->sizeClass = static_cast<uint32_t>(sizeClass);
+		slab->objectSize = static_cast<uint32_t>(CLASS_SIZES[sizeClass]);
+		slab->capacity = static_cast<uint32_t>((SLAB_SIZE - OBJECTS_OFFSET) / slab->objectSize);
+		slab->freeCount = slab->capacity;
+		for (size_t word = 0; word < FREE_WORDS; ++word)
+		{
+			const size_t first = word * 64;
+			if (first + 64 <= slab->capacity)
+				slab->freeBits[word] = ~uint64_t{0};
+			else if (first < slab->capacity)
+				slab->freeBits[word] = (uint64_t{1} << (slab->capacity - first)) - 1;
+			else
+				slab->freeBits[word] = 0;
+		}
+		pushPartial(slab);
+		++slabCount;
+		return slab;
+	}
+
+	void pushPartial(Slab* slab)
+	{
+		Slab*& head = partial[slab->sizeClass];
+		slab->prev = nullptr;
+		slab->next = head;
+		if (head) head->prev = slab;
+		head = slab;
+	}
+
+	void unlink(Slab* slab)
+	{
+		if (slab->prev) slab->prev->next = slab->next;
+		else partial[slab->sizeClass] = slab->next;
+		if (slab->next) slab->next->prev = slab->prev;
+		slab->prev = slab->next = nullptr;
+	}
+
+	/// Gives the empty slabs back, slabs that still hold objects stay allocated in the heap
+	void releaseAll()
+	{
+		for (Slab*& head : partial)
+		{
+			while (head)
+			{
+				Slab* slab = head;
+				head = slab->next;
+				if (slab->freeCount == slab->capacity)
+				{
+					--slabCount;
+					heap.free(slab, SLAB_SIZE);
+				}
+			}
+		}
+	}
+private:
+	Heap& heap;
+	Slab* partial[CLASSES] = {};
+	size_t slabCount = 0;
+};
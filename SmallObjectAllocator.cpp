@@ -0,0 +1,105 @@
+#include "pch.h"
+#include "SmallObjectAllocator.h"
+#include <algorithm>
+
+SmallObjectAllocator::SmallObjectAllocator(const char* tag) noexcept
+	: m_Pools{},
+	  m_Tag{ tag },
+	  m_LargeBytes{ 0u }
+{
+}
+
+void* SmallObjectAllocator::Allocate(const size_t size, const size_t alignment) noexcept
+{
+	assert((alignment & (alignment - 1)) == 0 && "Alignment has to be a power of two");
+	const size_t sizeClass = ClassOf(size, alignment);
+	if (sizeClass == s_NrOfClasses)
+	{
+		void* pMemory = ::operator new(size, std::align_val_t{ alignment }, std::nothrow);
+		if (pMemory)
+			m_LargeBytes += size;
+		return pMemory;
+	}
+
+	if (!m_Pools[sizeClass])
+	{
+		//At least 16 chunks per block, small classes share the 64 KiB minimum.
+		const size_t classSize = s_ClassSizes[sizeClass];
+		const size_t blockSize = std::max<size_t>(64u * 1024u, std::bit_ceil(classSize * 16u));
+		m_Pools[sizeClass].reset(new(std::nothrow) PoolBlockChain(classSize, ClassAlignment(sizeClass), blockSize));
+		if (!m_Pools[sizeClass])
+			return nullptr;
+	}
+	return m_Pools[sizeClass]->Allocate();
+}
+
+void SmallObjectAllocator::Deallocate(void* pMemory, const size_t size, const size_t alignment) noexcept
+{
+	if (pMemory == nullptr)
+		return;
+
+	const size_t sizeClass = ClassOf(size, alignment);
+	if (sizeClass == s_NrOfClasses)
+	{
+		m_LargeBytes -= size;
+		::operator delete(pMemory, std::align_val_t{ alignment });
+		return;
+	}
+	assert(m_Pools[sizeClass] && "Memory wasn't allocated with this size");
+	m_Pools[sizeClass]->Deallocate(pMemory);
+}
+
+const char* SmallObjectAllocator::GetTag() const noexcept
+{
+	return m_Tag;
+}
+
+const uint64_t SmallObjectAllocator::GetUsage() const noexcept
+{
+	uint64_t usage = m_LargeBytes;
+	for (size_t sizeClass{ 0u }; sizeClass < s_NrOfClasses; sizeClass++)
+	{
+		if (m_Pools[sizeClass])
+			usage += m_Pools[sizeClass]->GetUsedChunks() * m_Pools[sizeClass]->GetChunkSize();
+	}
+	return usage;
+}
+
+const uint64_t SmallObjectAllocator::GetCapacity() const noexcept
+{
+	uint64_t capacity = m_LargeBytes;
+	for (size_t sizeClass{ 0u }; sizeClass < s_NrOfClasses; sizeClass++)
+	{
+		if (m_Pools[sizeClass])
+			capacity += m_Pools[sizeClass]->GetBlockCount() * m_Pools[sizeClass]->GetBlockSize();
+	}
+	return capacity;
+}
+
+const uint64_t SmallObjectAllocator::GetBlockCount() const noexcept
+{
+	uint64_t nrOfBlocks = 0u;
+	for (size_t sizeClass{ 0u }; sizeClass < s_NrOfClasses; sizeClass++)
+	{
+		if (m_Pools[sizeClass])
+			nrOfBlocks += m_Pools[sizeClass]->GetBlockCount();
+	}
+	return nrOfBlocks;
+}
+
+const uint64_t SmallObjectAllocator::GetUsedChunks(const size_t sizeClass) const noexcept
+{
+	return m_Pools[sizeClass] ? m_Pools[sizeClass]->GetUsedChunks() : 0u;
+}
+
+size_t SmallObjectAllocator::ClassOf(const size_t size, const size_t alignment) noexcept
+{
+	if (size > s_MaxSize)
+		return s_NrOfClasses;
+
+	//Classes that aren't aligned enough are skipped, so 8 bytes with the default alignment get a 16 byte chunk.
+	size_t sizeClass = s_ClassOf[(size + s_Granule - 1u) / s_Granule];
+	while (sizeClass < s_NrOfClasses && ClassAlignment(sizeClass) < alignment)
+		sizeClass++;
+	return sizeClass;
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include "PoolBlockChain.h"
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+//Objects of any type up to 16 KiB out of one allocator: one PoolBlockChain per size class,
+//created when the class is first used. The classes grow by about 1.5x (8, 16, 32, 48, 80, ...),
+//so at most a third of a chunk is wasted, and a table indexed by size / 8 picks the class.
+//Chunks are aligned to the largest power of two that divides their size, up to 64 bytes; every
+//class from 16 bytes up is 16 byte aligned. Bigger or more aligned requests go to operator new.
+class SmallObjectAllocator
+{
+public:
+	static constexpr size_t s_MaxSize = 16u * 1024u;
+	static constexpr size_t s_MaxAlignment = 64u;
+private:
+	static constexpr size_t s_Granule = 8u;
+
+	//8, then 16, then x1.5 rounded up to a multiple of 16, capped at s_MaxSize.
+	static constexpr auto s_ClassSizes = []
+	{
+		constexpr auto next = [](const size_t size) -> size_t
+		{
+			if (size < 16u)
+				return 16u;
+			const size_t grown = (size * 3u / 2u + 15u) / 16u * 16u;
+			return grown < s_MaxSize ? grown : s_MaxSize;
+		};
+		constexpr size_t nrOfClasses = [next]
+		{
+			size_t count = 1u;
+			for (size_t size = 8u; size < s_MaxSize; size = next(size))
+				count++;
+			return count;
+		}();
+		std::array<uint32_t, nrOfClasses> sizes{};
+		size_t size = 8u;
+		for (size_t i{ 0u }; i < nrOfClasses; i++, size = next(size))
+			sizes[i] = static_cast<uint32_t>(size);
+		return sizes;
+	}();
+public:
+	static constexpr size_t s_NrOfClasses = s_ClassSizes.size();
+private:
+	//Size rounded up to s_Granule -> smallest class that fits.
+	static constexpr auto s_ClassOf = []
+	{
+		std::array<uint8_t, s_MaxSize / s_Granule + 1u> table{};
+		size_t sizeClass = 0u;
+		for (size_t i{ 0u }; i < table.size(); i++)
+		{
+			while (s_ClassSizes[sizeClass] < i * s_Granule)
+				sizeClass++;
+			table[i] = static_cast<uint8_t>(sizeClass);
+		}
+		return table;
+	}();
+public:
+	SmallObjectAllocator(const char* tag) noexcept;
+	~SmallObjectAllocator() = default;
+	SmallObjectAllocator(const SmallObjectAllocator&) = delete;
+	SmallObjectAllocator& operator=(const SmallObjectAllocator&) = delete;
+
+	//alignment has to be a power of two. Returns nullptr when out of memory.
+	[[nodiscard]] void* Allocate(const size_t size, const size_t alignment = alignof(std::max_align_t)) noexcept;
+	//size and alignment have to be the ones the memory was allocated with.
+	void Deallocate(void* pMemory, const size_t size, const size_t alignment = alignof(std::max_align_t)) noexcept;
+	template<typename T, typename... Arguments>
+	T* New(Arguments&&... args);
+	template<typename T>
+	void Delete(T* pData);
+
+	[[nodiscard]] static constexpr size_t GetClassSize(const size_t sizeClass) noexcept { return s_ClassSizes[sizeClass]; }
+	[[nodiscard]] const char* GetTag() const noexcept;
+	//Bytes in handed out chunks, plus the allocations that went to operator new.
+	[[nodiscard]] const uint64_t GetUsage() const noexcept;
+	//Bytes in the blocks of all classes, plus the allocations that went to operator new.
+	[[nodiscard]] const uint64_t GetCapacity() const noexcept;
+	[[nodiscard]] const uint64_t GetBlockCount() const noexcept;
+	[[nodiscard]] const uint64_t GetUsedChunks(const size_t sizeClass) const noexcept;
+
+private:
+	//s_NrOfClasses when no class can hold it.
+	[[nodiscard]] static size_t ClassOf(const size_t size, const size_t alignment) noexcept;
+	[[nodiscard]] static constexpr size_t ClassAlignment(const size_t sizeClass) noexcept;
+
+	std::unique_ptr<PoolBlockChain> m_Pools[s_NrOfClasses];
+	const char* m_Tag;
+	uint64_t m_LargeBytes;
+};
+
+template<typename T, typename ...Arguments>
+T* SmallObjectAllocator::New(Arguments&&... args)
+{
+	void* pMemory = Allocate(sizeof(T), alignof(T));
+	if (pMemory == nullptr)
+		return nullptr;
+	return new(pMemory)T(std::forward<Arguments>(args)...);
+}
+
+template<typename T>
+void SmallObjectAllocator::Delete(T* pData)
+{
+	pData->~T();
+	Deallocate(pData, sizeof(T), alignof(T));
+}
+
+constexpr size_t SmallObjectAllocator::ClassAlignment(const size_t sizeClass) noexcept
+{
+	const size_t alignment = size_t{ 1u } << std::countr_zero(s_ClassSizes[sizeClass]);
+	return alignment < s_MaxAlignment ? alignment : s_MaxAlignment;
+}
@@ -2,16 +2,23 @@
 #include "Stack.h"
 
 //Will only be called when allocating the whole stack memory.
-Stack::Stack(unsigned long long stackSize)
+Stack::Stack(unsigned long long stackSize, PageBacking backing)
 {
-	//Allocate the stack itself.
-	m_pData = DBG_NEW std::byte[stackSize];
+	//Allocate the stack itself. Huge pages are only used for a whole number of them.
+	const size_t hugePageSize = VirtualMemory::GetHugePageSize();
+	const size_t pageSize = backing == PageBacking::Huge && hugePageSize ? hugePageSize : VirtualMemory::GetPageSize();
+	m_mappedSize = (stackSize + pageSize - 1) / pageSize * pageSize;
+	m_pData = static_cast<std::byte*>(VirtualMemory::AllocateAligned(m_mappedSize, pageSize, backing, &m_pageBacking));
+	if (!m_pData)
+	{
+		throw std::bad_alloc();
+	}
 	m_stackSize = stackSize;
 	m_currentSize = 0;
 }
 
 Stack::~Stack()
 {
-	delete[] m_pData;
+	VirtualMemory::Release(m_pData, m_mappedSize);
 	m_pData = nullptr;
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #pragma once
+#include "VirtualMemory.h"
 
 class ObjectHeader
 {
@@ -22,7 +23,7 @@ private:
 class Stack
 {
 public:
-    Stack(unsigned long long stackSize);
+    Stack(unsigned long long stackSize, PageBacking backing = PageBacking::Small);
     ~Stack();
 
     //Pointer to the actual data.
@@ -31,5 +32,9 @@ public:
     size_t m_stackSize;
     //Current space taken in the stack.
     size_t m_currentSize;
+    //Bytes actually mapped, the stack size rounded up to whole pages.
+    size_t m_mappedSize;
+    //Page size the OS gave us for the stack.
+    PageBacking m_pageBacking;
 private:
 };
\ No newline at end of file
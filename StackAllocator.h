@@ -13,7 +13,7 @@ class StackAllocator
     //Protected so that no one else can create StackAllocators.
 protected:
     //Constructor is called only by CreateAllocator.
-    StackAllocator(unsigned long long);
+    StackAllocator(unsigned long long, PageBacking);
     //Called when we delete the allocator in the FreeMemory-function.
     ~StackAllocator();
 
@@ -23,7 +23,7 @@ public:
     void operator=(const StackAllocator&) = delete;
 
     //Used to create the allocator if it does not exist.
-    static void CreateAllocator(unsigned long long);
+    static void CreateAllocator(unsigned long long, PageBacking = PageBacking::Small);
     static void FreeAllMemory();
     //Returns the instance of the singleton.
     static StackAllocator* GetInstance();
@@ -60,12 +60,12 @@ ObjectHeader* StackAllocator::m_pTop{ nullptr };
 
 //---------------------------------------------------------------------
 
-void StackAllocator::CreateAllocator(unsigned long long stackSize)
+void StackAllocator::CreateAllocator(unsigned long long stackSize, PageBacking backing)
 {
     //Only create it if it does not exist.
     if (!pInstance)
     {
-        pInstance = DBG_NEW StackAllocator(stackSize);
+        pInstance = DBG_NEW StackAllocator(stackSize, backing);
     }
     else
     {
@@ -105,10 +105,10 @@ size_t StackAllocator::GetStackCurrentSize()
     return m_pMemoryStack->m_currentSize;
 }
 
-StackAllocator::StackAllocator(unsigned long long stackSize)
+StackAllocator::StackAllocator(unsigned long long stackSize, PageBacking backing)
 {
     //Allocate the "header" of the stack.
-    m_pMemoryStack = DBG_NEW Stack(stackSize);
+    m_pMemoryStack = DBG_NEW Stack(stackSize, backing);
 
     //Set the bytewalker to be the start of the allocated memory.
     m_pByteWalker = m_pMemoryStack->m_pData;
@@ -0,0 +1,198 @@
+#include "pch.h"
+#include "VirtualMemory.h"
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+#endif
+
+namespace
+{
+#if defined(_WIN32)
+	//Large pages need SeLockMemoryPrivilege, which has to be granted to the user and enabled in the process token.
+	bool EnableLockMemoryPrivilege() noexcept
+	{
+		HANDLE token = nullptr;
+		if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+			return false;
+		TOKEN_PRIVILEGES privileges = {};
+		privileges.PrivilegeCount = 1;
+		privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+		bool enabled = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)
+			&& AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr)
+			&& GetLastError() == ERROR_SUCCESS;
+		CloseHandle(token);
+		return enabled;
+	}
+#endif
+}
+
+void* VirtualMemory::Reserve(const size_t size) noexcept
+{
+#if defined(_WIN32)
+	return VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+	void* pAddress = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return pAddress == MAP_FAILED ? nullptr : pAddress;
+#endif
+}
+
+void* VirtualMemory::ReserveAligned(const size_t size, const size_t alignment) noexcept
+{
+	if (alignment <= GetPageSize())
+		return Reserve(size);
+#if defined(_WIN32)
+	//Reserve enough to contain an aligned range, then release it and reserve exactly that range.
+	//Another thread can grab the range in between, so retry a few times.
+	for (int attempt = 0; attempt < 8; attempt++)
+	{
+		void* pPadded = VirtualAlloc(nullptr, size + alignment, MEM_RESERVE, PAGE_NOACCESS);
+		if (!pPadded)
+			return nullptr;
+		const uintptr_t aligned = (reinterpret_cast<uintptr_t>(pPadded) + alignment - 1) & ~(alignment - 1);
+		VirtualFree(pPadded, 0, MEM_RELEASE);
+		void* pAddress = VirtualAlloc(reinterpret_cast<void*>(aligned), size, MEM_RESERVE, PAGE_NOACCESS);
+		if (pAddress)
+			return pAddress;
+	}
+	return nullptr;
+#else
+	//Over-reserve and unmap the unaligned head and the tail.
+	std::byte* pPadded = static_cast<std::byte*>(Reserve(size + alignment));
+	if (!pPadded)
+		return nullptr;
+	const uintptr_t aligned = (reinterpret_cast<uintptr_t>(pPadded) + alignment - 1) & ~(alignment - 1);
+	std::byte* pAddress = reinterpret_cast<std::byte*>(aligned);
+	const size_t head = pAddress - pPadded;
+	if (head)
+		munmap(pPadded, head);
+	if (alignment - head)
+		munmap(pAddress + size, alignment - head);
+	return pAddress;
+#endif
+}
+
+void* VirtualMemory::AllocateAligned(const size_t size, const size_t alignment, const PageBacking backing, PageBacking* pUsedBacking) noexcept
+{
+	if (pUsedBacking)
+		*pUsedBacking = PageBacking::Small;
+	const size_t hugePageSize = GetHugePageSize();
+	const bool tryHugePages = backing == PageBacking::Huge && hugePageSize && size % hugePageSize == 0;
+#if defined(_WIN32)
+	if (tryHugePages && EnableLockMemoryPrivilege())
+	{
+		//Large pages can't be committed later, the whole range is reserved and committed at once.
+		const size_t hugeAlignment = alignment > hugePageSize ? alignment : hugePageSize;
+		for (int attempt = 0; attempt < 8; attempt++)
+		{
+			void* pPadded = VirtualAlloc(nullptr, size + hugeAlignment, MEM_RESERVE, PAGE_NOACCESS);
+			if (!pPadded)
+				break;
+			const uintptr_t aligned = (reinterpret_cast<uintptr_t>(pPadded) + hugeAlignment - 1) & ~(hugeAlignment - 1);
+			VirtualFree(pPadded, 0, MEM_RELEASE);
+			void* pAddress = VirtualAlloc(reinterpret_cast<void*>(aligned), size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			if (pAddress)
+			{
+				if (pUsedBacking)
+					*pUsedBacking = PageBacking::Huge;
+				return pAddress;
+			}
+		}
+	}
+	void* pAddress = ReserveAligned(size, alignment);
+	if (pAddress && !Commit(pAddress, size))
+	{
+		Release(pAddress, size);
+		return nullptr;
+	}
+	return pAddress;
+#else
+	//Huge page aligned, so that transparent huge pages can back the range from its start.
+	const size_t hugeAlignment = hugePageSize && alignment < hugePageSize ? hugePageSize : alignment;
+	void* pAddress = ReserveAligned(size, backing == PageBacking::Huge ? hugeAlignment : alignment);
+	if (!pAddress)
+		return nullptr;
+#if defined(MAP_HUGETLB)
+	//Explicit huge pages come from the preallocated pool (vm.nr_hugepages) and usually fail when it is empty.
+	if (tryHugePages && mmap(pAddress, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0) != MAP_FAILED)
+	{
+		if (pUsedBacking)
+			*pUsedBacking = PageBacking::Huge;
+		return pAddress;
+	}
+#endif
+	//Map over the reservation again, a failed MAP_FIXED may have removed it.
+	if (mmap(pAddress, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0) == MAP_FAILED)
+	{
+		Release(pAddress, size);
+		return nullptr;
+	}
+#if defined(MADV_HUGEPAGE)
+	if (backing == PageBacking::Huge && madvise(pAddress, size, MADV_HUGEPAGE) == 0 && pUsedBacking)
+		*pUsedBacking = PageBacking::Huge;
+#endif
+	return pAddress;
+#endif
+}
+
+bool VirtualMemory::Commit(void* pAddress, const size_t size) noexcept
+{
+#if defined(_WIN32)
+	return VirtualAlloc(pAddress, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+	return mprotect(pAddress, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+void VirtualMemory::Decommit(void* pAddress, const size_t size) noexcept
+{
+#if defined(_WIN32)
+	VirtualFree(pAddress, size, MEM_DECOMMIT);
+#else
+	madvise(pAddress, size, MADV_DONTNEED);
+	mprotect(pAddress, size, PROT_NONE);
+#endif
+}
+
+void VirtualMemory::Release(void* pAddress, const size_t size) noexcept
+{
+	if (!pAddress)
+		return;
+#if defined(_WIN32)
+	VirtualFree(pAddress, 0, MEM_RELEASE);
+#else
+	munmap(pAddress, size);
+#endif
+}
+
+size_t VirtualMemory::GetPageSize() noexcept
+{
+#if defined(_WIN32)
+	SYSTEM_INFO systemInfo = {};
+	GetSystemInfo(&systemInfo);
+	return systemInfo.dwPageSize;
+#else
+	return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+size_t VirtualMemory::GetHugePageSize() noexcept
+{
+#if defined(_WIN32)
+	return GetLargePageMinimum();
+#else
+	//"Hugepagesize:    2048 kB"
+	std::ifstream meminfo("/proc/meminfo");
+	std::string key;
+	size_t kiloBytes = 0;
+	while (meminfo >> key)
+	{
+		if (key == "Hugepagesize:" && meminfo >> kiloBytes)
+			return kiloBytes * 1024;
+		meminfo.ignore(256, '\n');
+	}
+	return 0;
+#endif
+}
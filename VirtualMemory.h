@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+
+//Page size backing an allocation. Huge pages (2 MiB on x64) cover the same memory with far fewer
+//TLB entries, which matters when large arenas are accessed randomly.
+enum class PageBacking
+{
+	Small,
+	Huge
+};
+
+//Thin wrapper around the OS virtual memory API. Lets allocators reserve a large
+//address range up front and only commit the pages they actually touch.
+class VirtualMemory
+{
+public:
+	//Reserves address space only, nothing is backed by physical memory yet. Returns nullptr on failure.
+	[[nodiscard]] static void* Reserve(const size_t size) noexcept;
+	//Same as Reserve but the start of the range is a multiple of alignment (a power of two).
+	[[nodiscard]] static void* ReserveAligned(const size_t size, const size_t alignment) noexcept;
+	//Makes the pages in [pAddress, pAddress + size) readable/writable. Fresh pages read as zero.
+	[[nodiscard]] static bool Commit(void* pAddress, const size_t size) noexcept;
+	//Gives the physical pages back to the OS but keeps the address range reserved.
+	static void Decommit(void* pAddress, const size_t size) noexcept;
+	//Reserves and commits in one go, aligned like ReserveAligned. PageBacking::Huge first tries explicit huge pages
+	//(MEM_LARGE_PAGES / MAP_HUGETLB, only when size is a multiple of GetHugePageSize()), then falls back to small
+	//pages, on Linux with a transparent huge page hint (reported as Huge when the kernel accepts it). The backing
+	//that was granted is written to pUsedBacking. Free with Release.
+	[[nodiscard]] static void* AllocateAligned(const size_t size, const size_t alignment, const PageBacking backing, PageBacking* pUsedBacking = nullptr) noexcept;
+	//Releases a range previously returned by Reserve or AllocateAligned.
+	static void Release(void* pAddress, const size_t size) noexcept;
+	[[nodiscard]] static size_t GetPageSize() noexcept;
+	//Size of a huge page, 0 if the system has none.
+	[[nodiscard]] static size_t GetHugePageSize() noexcept;
+};